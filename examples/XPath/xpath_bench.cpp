@@ -0,0 +1,98 @@
+#ifdef _MSC_VER
+#pragma warning(disable: 4786 4250 4503)
+#endif
+
+// xpath_bench [elements]
+// Builds a document of <item> elements and times a handful of XPath
+// expressions against it.  Not a test - just numbers to compare before
+// and after a change.
+
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+#include <DOM/Simple/DOMImplementation.hpp>
+#include <XPath/XPath.hpp>
+
+typedef Arabica::DOM::Document<std::string> Document;
+typedef Arabica::DOM::Element<std::string> Element;
+typedef Arabica::DOM::Node<std::string> Node;
+
+Document buildDocument(int elements)
+{
+  Arabica::DOM::DOMImplementation<std::string> factory = Arabica::SimpleDOM::DOMImplementation<std::string>::getDOMImplementation();
+  Document doc = factory.createDocument("", "items", 0);
+  Element root = doc.getDocumentElement();
+
+  const char* values[] = { "a", "1", "b", "2.5", "c", "-3", "x", "42" };
+  for(int i = 0; i != elements; ++i)
+  {
+    Element item = doc.createElement("item");
+    item.appendChild(doc.createTextNode(values[i % 8]));
+    root.appendChild(item);
+  } // for ...
+
+  return doc;
+} // buildDocument
+
+void report(const std::string& what, double matched, std::clock_t elapsed)
+{
+  std::cout << what << " : " << matched << " matched, "
+            << (elapsed * 1000.0 / CLOCKS_PER_SEC) << "ms" << std::endl;
+} // report
+
+// evaluates a predicate once for each child of the document element, as
+// the predicate of //item[...] would be - without the document order sort
+// that the full location path does at the end
+void timePredicate(const char* predicate, const Document& doc)
+{
+  Arabica::XPath::XPath<std::string> parser;
+  Arabica::XPath::XPathExpression<std::string> xpath = parser.compile_expr(predicate);
+
+  double matched = 0;
+  std::clock_t start = std::clock();
+  for(Node item = doc.getDocumentElement().getFirstChild(); item != 0; item = item.getNextSibling())
+    if(xpath.evaluateAsBool(item))
+      ++matched;
+  report(std::string("//item[") + predicate + "]", matched, std::clock() - start);
+} // timePredicate
+
+// evaluates an expression once, from the document
+void timeExpression(const char* expression, const Document& doc)
+{
+  Arabica::XPath::XPath<std::string> parser;
+  Arabica::XPath::XPathExpression<std::string> xpath = parser.compile_expr(expression);
+
+  std::clock_t start = std::clock();
+  double result = xpath.evaluateAsNumber(doc);
+  report(expression, result, std::clock() - start);
+} // timeExpression
+
+int main(int argc, char* argv[])
+{
+  int elements = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+
+  std::cout << "building " << elements << " elements" << std::endl;
+  Document doc = buildDocument(elements);
+
+  // string-value of every element
+  timePredicate(". = 'x'", doc);
+  // string to number conversion, half of it on text that isn't a number
+  timePredicate(". > 0", doc);
+  // typed operands and a constant subexpression
+  timePredicate("string-length(.) > 1 + 1 or false()", doc);
+  // nothing but core function calls
+  timePredicate("contains(concat(., 'x'), 'ax')", doc);
+  // a literal regular expression
+  timePredicate("matches(., '^-?[0-9]+$')", doc);
+  // sibling navigation in a flat document
+  timePredicate("following-sibling::*[1] = 'x' or preceding-sibling::*[last()] = 'x'", doc);
+
+  // aggregates over the whole document
+  timeExpression("count(//item)", doc);
+  timeExpression("count(/items/item/text())", doc);
+  timeExpression("sum(/items/item)", doc);
+  timeExpression("number(boolean(/items/item/text()))", doc);
+
+  return 0;
+} // main
@@ -70,7 +70,13 @@ class DOMImplementationImpl : public DOM::DOMImplementation_impl<stringT, string
       DocumentImpl<stringT, string_adaptorT>* doc = new DocumentImpl<stringT, string_adaptorT>(namespaceURI, qualifiedName, docType, this);
 
       if(!string_adaptorT::empty(qualifiedName))
+      {
+        // mutation events hold references to the document while they're 
+        // dispatched, so keep it alive until the caller takes ownership
+        doc->addRef();
         doc->appendChild(doc->createElementNS(namespaceURI, qualifiedName));
+        doc->detachRef();
+      } // if ...
 
       return doc;
     } // createDocument
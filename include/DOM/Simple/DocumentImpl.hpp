@@ -18,6 +18,10 @@
 #include <DOM/Simple/DocumentEventImpl.hpp>
 
 #include <set>
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include <boost/shared_ptr.hpp>
 #include <algorithm>
 
 namespace Arabica
@@ -56,6 +60,9 @@ class DocumentImpl : public DOM::Document_impl<stringT, string_adaptorT>,
     typedef DOM::Document_impl<stringT, string_adaptorT> DOMDocument_implT;
     typedef DOM::DocumentType_impl<stringT, string_adaptorT> DOMDocumentType_implT;
     typedef DOM::DOMImplementation<stringT, string_adaptorT> DOMDOMImplementationT;
+    typedef std::vector<DOMNode_implT*> ElementListT;
+    typedef std::vector<std::pair<stringT, stringT> > NamespaceListT;
+    typedef boost::shared_ptr<const NamespaceListT> NamespaceListPtrT;
 
     DocumentImpl() : 
         NodeWithChildrenT(0),
@@ -66,6 +73,14 @@ class DocumentImpl : public DOM::Document_impl<stringT, string_adaptorT>,
         qualifiedName_(),
         changesCount_(0),
         refCount_(0),
+        nameIndexChanges_(0),
+        nameIndexBuilt_(false),
+        attributeChangesCount_(0),
+        attributeIndexing_(false),
+        attributeIndexChanges_(0),
+        attributeIndexAttributeChanges_(0),
+        namespacesChanges_(0),
+        namespacesAttributeChanges_(0),
         empty_()
     { 
       NodeImplT::setOwnerDoc(this);
@@ -79,7 +94,15 @@ class DocumentImpl : public DOM::Document_impl<stringT, string_adaptorT>,
         namespaceURI_(),
         qualifiedName_(),
         changesCount_(0),
-        refCount_(0)
+        refCount_(0),
+        nameIndexChanges_(0),
+        nameIndexBuilt_(false),
+        attributeChangesCount_(0),
+        attributeIndexing_(false),
+        attributeIndexChanges_(0),
+        attributeIndexAttributeChanges_(0),
+        namespacesChanges_(0),
+        namespacesAttributeChanges_(0)
     { 
       NodeImplT::setOwnerDoc(this);
     } // DocumentBaseImpl
@@ -95,14 +118,24 @@ class DocumentImpl : public DOM::Document_impl<stringT, string_adaptorT>,
         namespaceURI_(namespaceURI),
         qualifiedName_(qualifiedName),
         changesCount_(0),
-        refCount_(0)
+        refCount_(0),
+        nameIndexChanges_(0),
+        nameIndexBuilt_(false),
+        attributeChangesCount_(0),
+        attributeIndexing_(false),
+        attributeIndexChanges_(0),
+        attributeIndexAttributeChanges_(0),
+        namespacesChanges_(0),
+        namespacesAttributeChanges_(0)
     { 
       NodeImplT::setOwnerDoc(this);
       if(docType)
       {
         if(docType->getOwnerDocument() != 0)
           throw DOM::DOMException(DOM::DOMException::WRONG_DOCUMENT_ERR);
+        addRef();
         appendChild(docType);
+        detachRef();
       } // if(docType)
     } // DocumentBaseImpl
 
@@ -125,6 +158,13 @@ class DocumentImpl : public DOM::Document_impl<stringT, string_adaptorT>,
         delete this;
     } // releaseRef
 
+    // drops a reference taken while the document was being built, 
+    // without deleting it when the count reaches zero
+    void detachRef()
+    {
+      --refCount_;
+    } // detachRef
+
     /////////////////////////////////////////////////////////////////////
     // DOM::Document functions
     virtual DOMDocumentType_implT* getDoctype() const
@@ -451,6 +491,7 @@ class DocumentImpl : public DOM::Document_impl<stringT, string_adaptorT>,
     virtual DOMNode_implT* cloneNode(bool deep) const
     {
       DocumentImpl* clone = new DocumentImpl(namespaceURI_, qualifiedName_, 0, domImplementation_);
+      clone->addRef();
       if(documentType_ != 0)
       {
         DocumentTypeImpl<stringT, string_adaptorT>* dt = dynamic_cast<DocumentTypeImpl<stringT, string_adaptorT>*>(documentType_->cloneNode(true));
@@ -463,6 +504,7 @@ class DocumentImpl : public DOM::Document_impl<stringT, string_adaptorT>,
           if((documentType_ != child) && (child != clone->getDocumentElement()))
             clone->appendChild(clone->importNode(child, true));
 
+      clone->detachRef();
       return clone;
     } // cloneNode
 
@@ -470,6 +512,7 @@ class DocumentImpl : public DOM::Document_impl<stringT, string_adaptorT>,
     // extensions
     void markChanged() { ++changesCount_; }
     unsigned long changes() const { return changesCount_; }
+    void markAttributesChanged() { ++attributeChangesCount_; }
 
     void orphaned(NodeImplT* node) const
     { 
@@ -513,7 +556,232 @@ class DocumentImpl : public DOM::Document_impl<stringT, string_adaptorT>,
 
     const stringT& empty_string() const { return empty_; }
 
+    // All the elements in the document with the given expanded name, in 
+    // document order.  Elements in no namespace are keyed on their node
+    // name.  The index is built on first use, and rebuilt the next time it's
+    // asked for after the tree has changed.
+    const ElementListT& elementsByName(const stringT& namespaceURI, const stringT& name) const
+    {
+      if(!nameIndexBuilt_ || (nameIndexChanges_ != changesCount_))
+        buildNameIndex();
+
+      typename NameIndexT::const_iterator i = nameIndex_.find(std::make_pair(namespaceURI, name));
+      return (i != nameIndex_.end()) ? i->second : noElements_;
+    } // elementsByName
+
+    // The attribute value index is off until asked for, since it can cost
+    // as much memory as the attributes themselves.
+    void setAttributeIndexing(bool on) 
+    { 
+      attributeIndexing_ = on; 
+      if(!on)
+        AttributeIndexT().swap(attributeIndex_);
+    } // setAttributeIndexing
+    bool attributeIndexing() const { return attributeIndexing_; }
+
+    // All the elements with the given expanded name which have an attribute
+    // in no namespace with the given name and value, in document order.  An
+    // empty element name matches any element.  Each element and attribute 
+    // name pair gets a table of values, built on first use.  All the tables
+    // are thrown away when the tree or any attribute changes.
+    const ElementListT& elementsByAttribute(const stringT& namespaceURI, 
+                                            const stringT& name, 
+                                            const stringT& attributeName, 
+                                            const stringT& value) const
+    {
+      if((attributeIndexChanges_ != changesCount_) || (attributeIndexAttributeChanges_ != attributeChangesCount_))
+      {
+        AttributeIndexT().swap(attributeIndex_);
+        attributeIndexChanges_ = changesCount_;
+        attributeIndexAttributeChanges_ = attributeChangesCount_;
+      } // if ...
+
+      AttributeKeyT key(std::make_pair(namespaceURI, name), attributeName);
+      typename AttributeIndexT::iterator t = attributeIndex_.find(key);
+      if(t == attributeIndex_.end())
+        t = buildAttributeIndex(key);
+
+      typename ValueIndexT::const_iterator i = t->second.find(value);
+      return (i != t->second.end()) ? i->second : noElements_;
+    } // elementsByAttribute
+
+    // The namespaces in scope at an element, as prefix and URI pairs - the
+    // element's own declarations first, then its parent's, and so on up.
+    // Each prefix appears once, and the xml prefix not at all.  An element 
+    // that declares nothing shares its parent's list.  Lists for elements in
+    // the tree are kept until the tree or any attribute changes.
+    NamespaceListPtrT inScopeNamespaces(DOMNode_implT* element) const
+    {
+      if((namespacesChanges_ != changesCount_) || (namespacesAttributeChanges_ != attributeChangesCount_))
+      {
+        NamespacesT().swap(namespaces_);
+        namespacesChanges_ = changesCount_;
+        namespacesAttributeChanges_ = attributeChangesCount_;
+      } // if ...
+
+      typename NamespacesT::const_iterator n = namespaces_.find(element);
+      if(n != namespaces_.end())
+        return n->second;
+
+      // find the nearest ancestor already done, then work back down
+      std::vector<DOMNode_implT*> ancestors;
+      NamespaceListPtrT inScope;
+      DOMNode_implT* e = element;
+      for( ; (e != 0) && (e->getNodeType() == DOM::Node_base::ELEMENT_NODE); e = e->getParentNode())
+      {
+        n = namespaces_.find(e);
+        if(n != namespaces_.end())
+        {
+          inScope = n->second;
+          break;
+        } // if ...
+        ancestors.push_back(e);
+      } // for ...
+      // elements outside the tree can be deleted without the tree changing
+      bool inTree = (inScope != 0) || (e == this);
+
+      if(inScope == 0)
+      {
+        if(noNamespaces_ == 0)
+          noNamespaces_.reset(new NamespaceListT());
+        inScope = noNamespaces_;
+      } // if ...
+      for(typename std::vector<DOMNode_implT*>::const_reverse_iterator a = ancestors.rbegin(), ae = ancestors.rend(); a != ae; ++a)
+      {
+        inScope = declaredNamespaces(*a, inScope);
+        if(inTree)
+          namespaces_[*a] = inScope;
+      } // for ...
+      return inScope;
+    } // inScopeNamespaces
+
+    // The namespaces in scope at an element, given those in scope at its
+    // parent.  Works on any DOM's nodes.
+    static NamespaceListPtrT declaredNamespaces(const DOMNode_implT* element, const NamespaceListPtrT& inherited)
+    {
+      if(!element->hasAttributes())
+        return inherited;
+
+      static const stringT xmlns = string_adaptorT::construct_from_utf8("xmlns");
+      static const stringT xml = string_adaptorT::construct_from_utf8("xml");
+      NamespaceListT declared;
+      const DOM::NamedNodeMap_impl<stringT, string_adaptorT>* attrs = element->getAttributes();
+      for(unsigned int a = 0, ae = attrs->getLength(); a != ae; ++a)
+      {
+        const DOMNode_implT* attr = attrs->item(a);
+        if((attr->getPrefix() == xmlns) && (attr->getLocalName() != xml))
+          declared.push_back(std::make_pair(attr->getLocalName(), attr->getNodeValue()));
+        else if(attr->getNodeName() == xmlns)
+          declared.push_back(std::make_pair(string_adaptorT::empty_string(), attr->getNodeValue()));
+      } // for ...
+      if(declared.empty())
+        return inherited;
+
+      size_t own = declared.size();
+      for(typename NamespaceListT::const_iterator i = inherited->begin(), ie = inherited->end(); i != ie; ++i)
+      {
+        bool overridden = false;
+        for(size_t d = 0; (d != own) && !overridden; ++d)
+          overridden = (declared[d].first == i->first);
+        if(!overridden)
+          declared.push_back(*i);
+      } // for ...
+
+      // xmlns="" takes the default namespace out of scope
+      for(size_t d = 0; d != own; ++d)
+        if(string_adaptorT::empty(declared[d].second))
+        {
+          declared.erase(declared.begin() + d);
+          break;
+        } // if ...
+
+      return NamespaceListPtrT(new NamespaceListT(declared));
+    } // declaredNamespaces
+
   private:
+    typedef std::map<stringT, ElementListT> ValueIndexT;
+    typedef std::pair<std::pair<stringT, stringT>, stringT> AttributeKeyT;
+    typedef std::map<AttributeKeyT, ValueIndexT> AttributeIndexT;
+
+    // iterative pre-order walk, so deep documents don't blow the stack
+    DOMNode_implT* nextNode(DOMNode_implT* node) const
+    {
+      const DOMNode_implT* root = this;
+      DOMNode_implT* next = node->getFirstChild();
+      while((next == 0) && (node != 0))
+      {
+        next = node->getNextSibling();
+        if(next == 0)
+        {
+          node = node->getParentNode();
+          if(node == root)
+            node = 0;
+        } // if ...
+      } // while ...
+      return next;
+    } // nextNode
+
+    void buildNameIndex() const
+    {
+      NameIndexT index;
+
+      for(DOMNode_implT* node = NodeWithChildrenT::getFirstChild(); node != 0; node = nextNode(node))
+      {
+        if(node->getNodeType() == DOM::Node_base::ELEMENT_NODE)
+        {
+          const stringT& uri = node->getNamespaceURI();
+          if(string_adaptorT::empty(uri))
+            index[std::make_pair(uri, node->getNodeName())].push_back(node);
+          else
+            index[std::make_pair(uri, node->getLocalName())].push_back(node);
+        } // if ...
+      } // for ...
+
+      nameIndex_.swap(index);
+      nameIndexChanges_ = changesCount_;
+      nameIndexBuilt_ = true;
+    } // buildNameIndex
+
+    typename AttributeIndexT::iterator buildAttributeIndex(const AttributeKeyT& key) const
+    {
+      ValueIndexT values;
+
+      if(!string_adaptorT::empty(key.first.second))
+      {
+        const ElementListT& elements = elementsByName(key.first.first, key.first.second);
+        for(typename ElementListT::const_iterator e = elements.begin(), ee = elements.end(); e != ee; ++e)
+          indexAttribute(values, *e, key.second);
+      } // if ...
+      else 
+      {
+        for(DOMNode_implT* node = NodeWithChildrenT::getFirstChild(); node != 0; node = nextNode(node))
+          if(node->getNodeType() == DOM::Node_base::ELEMENT_NODE)
+            indexAttribute(values, node, key.second);
+      } // else
+
+      typename AttributeIndexT::iterator t = attributeIndex_.insert(std::make_pair(key, ValueIndexT())).first;
+      t->second.swap(values);
+      return t;
+    } // buildAttributeIndex
+
+    static void indexAttribute(ValueIndexT& values, DOMNode_implT* element, const stringT& attributeName)
+    {
+      if(!element->hasAttributes())
+        return;
+
+      const DOM::NamedNodeMap_impl<stringT, string_adaptorT>* attrs = element->getAttributes();
+      for(unsigned int a = 0, ae = attrs->getLength(); a != ae; ++a)
+      {
+        const DOMNode_implT* attr = attrs->item(a);
+        if((attr->getNodeName() == attributeName) && string_adaptorT::empty(attr->getNamespaceURI()))
+        {
+          values[attr->getNodeValue()].push_back(element);
+          return;
+        } // if ...
+      } // for ...
+    } // indexAttribute
+
+
     void checkChildType(DOMNode_implT* child)
     {
       typename DOM::Node_base::Type type = child->getNodeType();
@@ -533,12 +801,43 @@ class DocumentImpl : public DOM::Document_impl<stringT, string_adaptorT>,
     unsigned long changesCount_;
     unsigned long refCount_;
 
+    typedef std::map<std::pair<stringT, stringT>, ElementListT> NameIndexT;
+    mutable NameIndexT nameIndex_;
+    mutable unsigned long nameIndexChanges_;
+    mutable bool nameIndexBuilt_;
+    const ElementListT noElements_;
+
+    unsigned long attributeChangesCount_;
+    bool attributeIndexing_;
+    mutable AttributeIndexT attributeIndex_;
+    mutable unsigned long attributeIndexChanges_;
+    mutable unsigned long attributeIndexAttributeChanges_;
+
+    typedef std::unordered_map<const DOMNode_implT*, NamespaceListPtrT> NamespacesT;
+    mutable NamespacesT namespaces_;
+    mutable NamespaceListPtrT noNamespaces_;
+    mutable unsigned long namespacesChanges_;
+    mutable unsigned long namespacesAttributeChanges_;
+
     mutable std::set<NodeImplT*> orphans_;
     std::set<AttrImplT*> idNodes_;
     mutable std::set<stringT> stringPool_;
     const stringT empty_;
 }; // class DocumentImpl
 
+// Turns on, or off, the attribute value index XPath uses for predicates
+// like [@id='12345'].  Returns false if the document isn't a SimpleDOM
+// document.
+template<class stringT, class string_adaptorT>
+bool setAttributeIndexing(const DOM::Document<stringT, string_adaptorT>& document, bool on)
+{
+  DocumentImpl<stringT, string_adaptorT>* impl = dynamic_cast<DocumentImpl<stringT, string_adaptorT>*>(document.underlying_impl());
+  if(impl == 0)
+    return false;
+  impl->setAttributeIndexing(on);
+  return true;
+} // setAttributeIndexing
+
 } // namespace SAX2DOM
 } // namespace Arabica
 
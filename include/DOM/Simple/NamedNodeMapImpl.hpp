@@ -190,7 +190,10 @@ class NamedNodeMapImpl : public DOM::NamedNodeMap_impl<stringT, string_adaptorT>
     NodeImplT* setNode(typename NodeListT::iterator n, NodeImplT* arg)
     {
       if(ownerDoc_)
+      {
         ownerDoc_->adopted(arg);
+        ownerDoc_->markAttributesChanged();
+      } // if ...
       if(n == nodes_.end())
       {
         nodes_.push_back(arg);
@@ -210,6 +213,7 @@ class NamedNodeMapImpl : public DOM::NamedNodeMap_impl<stringT, string_adaptorT>
       NodeImplT* removedNode = *n;
       nodes_.erase(n);
       ownerDoc_->orphaned(removedNode);
+      ownerDoc_->markAttributesChanged();
       return removedNode;
     } // removeNode
 
@@ -0,0 +1,15 @@
+# 0 "/root/repo/vs7/ArabicaConfig.S"
+# 0 "<built-in>"
+# 0 "<command-line>"
+# 1 "/usr/include/stdc-predef.h" 1 3 4
+# 0 "<command-line>" 2
+# 1 "/root/repo/vs7/ArabicaConfig.S"
+# 14 "/root/repo/vs7/ArabicaConfig.S"
+ # ifndef ARABICA_ARABICA_CONFIG_H
+ # define ARABICA_ARABICA_CONFIG_H
+# 31 "/root/repo/vs7/ArabicaConfig.S"
+ # define HAVE_BOOST
+# 50 "/root/repo/vs7/ArabicaConfig.S"
+ # define ARABICA_USE_EXPAT
+# 69 "/root/repo/vs7/ArabicaConfig.S"
+ # endif
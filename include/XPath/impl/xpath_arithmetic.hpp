@@ -82,25 +82,19 @@ public:
 }; // class ModOperator
 
 template<class string_type, class string_adaptor>
-class UnaryNegative : public UnaryExpression<string_type, string_adaptor>
+class UnaryNegative : public UnaryExpression<string_type, string_adaptor>,
+                      public NumericExpression<string_type, string_adaptor>
 {
   typedef UnaryExpression<string_type, string_adaptor> baseT;
 public:
   UnaryNegative(XPathExpression_impl<string_type, string_adaptor>* expr) :
       UnaryExpression<string_type, string_adaptor>(expr) { }
 
-  virtual ValueType type() const { return NUMBER; }
-
-  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
-                                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
-  {
-    return NumericValue<string_type, string_adaptor>::createValue(evaluateAsNumber(context, executionContext));
-  } // evaluate
-  virtual double evaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context, 
-                                  const ExecutionContext<string_type, string_adaptor>& executionContext) const 
+  virtual double doEvaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context, 
+                                    const ExecutionContext<string_type, string_adaptor>& executionContext) const 
   {
     return -baseT::expr()->evaluateAsNumber(context, executionContext);
-  } // evaluateAsNumber
+  } // doEvaluateAsNumber
 }; // class UnaryNegative
 
 } // namespace impl
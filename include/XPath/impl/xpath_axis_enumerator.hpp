@@ -489,60 +489,100 @@ template<class string_type, class string_adaptor>
 class NamespaceAxisWalker : public AxisWalker<string_type, string_adaptor>
 {
   typedef AxisWalker<string_type, string_adaptor> BaseT;
+  typedef SimpleDOM::DocumentImpl<string_type, string_adaptor> DocumentImplT;
+  typedef typename DocumentImplT::NamespaceListT NamespaceListT;
+  typedef typename DocumentImplT::NamespaceListPtrT NamespaceListPtrT;
 public:
   typedef DOM::Node_impl<string_type, string_adaptor>* RawNodeT;
   
+  // The xml namespace comes first, then the element's in-scope namespaces.
+  // Those are shared between elements, and cached by SimpleDOM documents, 
+  // so namespace nodes are only made as the walk reaches them, and come
+  // from a pool of spares where there are any.
   NamespaceAxisWalker(const RawNodeT context) : BaseT(true),
-    xmlns_prefix_(string_adaptor::construct_from_utf8("xmlns")),
+    context_(context),
     index_(0)
   {
-    RawNodeT current = context;
-    if(current->getNodeType() != DOM::Node_base::ATTRIBUTE_NODE)
-      push_back(context, 
-                string_adaptor::construct_from_utf8("xml"), 
-                string_adaptor::construct_from_utf8("http://www.w3.org/XML/1998/namespace"));
-    while(current->getNodeType() == DOM::Node_base::ELEMENT_NODE)
-    {
-      for(unsigned int a = 0, ae = current->getAttributes()->getLength(); a != ae; ++a)
-      {
-        RawNodeT attr = current->getAttributes()->item(a);
-        if(attr->getPrefix() == xmlns_prefix_)
-          push_back(context, attr->getLocalName(), attr->getNodeValue());
-        if(attr->getNodeName() == xmlns_prefix_)
-          push_back(context, string_adaptor::empty_string(), attr->getNodeValue());
-      } // for ...
-      current = current->getParentNode();
-    } // while
-    list_.push_back(0);
-    BaseT::set(list_[index_]);
+    if(context->getNodeType() == DOM::Node_base::ATTRIBUTE_NODE)
+      return;
+    inScope_ = inScopeNamespaces(context);
+    moveTo(0);
   } // NamespaceAxisWalker
 
   virtual ~NamespaceAxisWalker()
   {
-    for(int i = 0; list_[i] != 0; ++i)
-      list_[i]->releaseRef();
+    if(BaseT::get() != 0)
+      BaseT::get()->releaseRef();
   } // ~NamespaceAxisWalker
 
   virtual void advance()
   {
-    if(index_ != list_.size())
-      BaseT::set(list_[++index_]);
+    if(BaseT::get() != 0)
+      moveTo(index_ + 1);
   } // advance
   
   virtual BaseT* clone() const { return new NamespaceAxisWalker(*this); }
 
 private:
-  void push_back(RawNodeT context, const string_type& prefix, const string_type& uri)
-  {
-    RawNodeT node = new NamespaceNodeImpl<string_type, string_adaptor>(context, prefix, uri);
-    node->addRef();
-    list_.push_back(node);
-  } // push_back
+  NamespaceAxisWalker(const NamespaceAxisWalker& rhs) : 
+    BaseT(rhs),
+    context_(rhs.context_),
+    inScope_(rhs.inScope_),
+    index_(rhs.index_)
+  { 
+    if(BaseT::get() != 0)
+      BaseT::get()->addRef();
+  } // NamespaceAxisWalker
 
-  NamespaceAxisWalker(const NamespaceAxisWalker& rhs) : BaseT(rhs) { }
-  std::vector<RawNodeT> list_;
-  const string_type xmlns_prefix_;
-  unsigned int index_;
+  void moveTo(size_t index)
+  {
+    RawNodeT previous = BaseT::get();
+    RawNodeT node = 0;
+    if(index == 0)
+      node = NamespaceNodeImpl<string_type, string_adaptor>::create(context_, xmlNamespace(), 0);
+    else if(index <= inScope_->size())
+      node = NamespaceNodeImpl<string_type, string_adaptor>::create(context_, inScope_, index - 1);
+    if(node != 0)
+      node->addRef();
+    BaseT::set(node);
+    index_ = index;
+    if(previous != 0)
+      previous->releaseRef();
+  } // moveTo
+
+  static NamespaceListPtrT inScopeNamespaces(const RawNodeT context)
+  {
+    if(context->getNodeType() != DOM::Node_base::ELEMENT_NODE)
+      return noNamespaces();
+
+    if(const DocumentImplT* document = dynamic_cast<const DocumentImplT*>(context->getOwnerDocument()))
+      return document->inScopeNamespaces(context);
+
+    std::vector<RawNodeT> ancestors;
+    for(RawNodeT e = context; (e != 0) && (e->getNodeType() == DOM::Node_base::ELEMENT_NODE); e = e->getParentNode())
+      ancestors.push_back(e);
+    NamespaceListPtrT inScope = noNamespaces();
+    for(typename std::vector<RawNodeT>::const_reverse_iterator a = ancestors.rbegin(), ae = ancestors.rend(); a != ae; ++a)
+      inScope = DocumentImplT::declaredNamespaces(*a, inScope);
+    return inScope;
+  } // inScopeNamespaces
+
+  static const NamespaceListPtrT& noNamespaces()
+  {
+    static const NamespaceListPtrT none(new NamespaceListT());
+    return none;
+  } // noNamespaces
+
+  static const NamespaceListPtrT& xmlNamespace()
+  {
+    static const NamespaceListPtrT xml(new NamespaceListT(1, std::make_pair(string_adaptor::construct_from_utf8("xml"), 
+                                                                            string_adaptor::construct_from_utf8("http://www.w3.org/XML/1998/namespace"))));
+    return xml;
+  } // xmlNamespace
+
+  RawNodeT context_;
+  NamespaceListPtrT inScope_;
+  size_t index_;
 }; // class NamespaceAxisWalker
 
 template<class string_type, class string_adaptor>
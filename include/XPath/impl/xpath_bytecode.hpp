@@ -0,0 +1,712 @@
+#ifndef ARABICA_XPATHIC_XPATH_BYTECODE_HPP
+#define ARABICA_XPATHIC_XPATH_BYTECODE_HPP
+
+#include <vector>
+#include <cmath>
+#include "xpath_object.hpp"
+#include "xpath_value.hpp"
+#include "xpath_expression.hpp"
+#include "xpath_arithmetic.hpp"
+#include "xpath_relational.hpp"
+#include "xpath_logical.hpp"
+#include "xpath_node_test.hpp"
+#include "xpath_function_holder.hpp"
+
+namespace Arabica
+{
+namespace XPath
+{
+namespace impl
+{
+
+template<class string_type, class string_adaptor> class TestStepExpression;
+template<class string_type, class string_adaptor> class RelativeLocationPath;
+template<class string_type, class string_adaptor> class AbsoluteLocationPath;
+
+// An expression tree flattened into a list of instructions over separate
+// number, boolean and string registers, so a predicate like
+// [string-length(.) > 2 or @type = 'x'] runs without building an
+// XPathValue or a node-set for each node it's asked about.
+//
+// Operators, the context node, simple attribute lookups and the cheap core
+// functions are lowered into instructions.  Anything else - location paths,
+// variables, extension functions - stays a leaf, evaluated through the tree
+// and converted to the type its parent wants.  The tree is not owned and
+// must outlive the Bytecode.
+template<class string_type, class string_adaptor>
+class Bytecode
+{
+public:
+  typedef XPathExpression_impl<string_type, string_adaptor> ExpressionT;
+
+  Bytecode() : type_(ANY), result_(0) { }
+  explicit Bytecode(const ExpressionT* expr) : type_(ANY), result_(0)
+  {
+    compile(expr);
+  } // Bytecode
+
+  // false if the expression wasn't worth lowering - evaluate the tree instead
+  bool compiled() const { return !code_.empty(); }
+
+  bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context,
+                      const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    Registers r;
+    run(r, context, executionContext);
+    switch(type_)
+    {
+      case BOOL: return r.bools[result_];
+      case NUMBER: return NumericValue<string_type, string_adaptor>(r.numbers[result_]).asBool();
+      default: return !string_adaptor::empty(*r.strings[result_]);
+    } // switch
+  } // evaluateAsBool
+
+  double evaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context,
+                          const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    Registers r;
+    run(r, context, executionContext);
+    switch(type_)
+    {
+      case BOOL: return r.bools[result_] ? 1 : 0;
+      case NUMBER: return r.numbers[result_];
+      default: return stringAsNumber<string_type, string_adaptor>(*r.strings[result_]);
+    } // switch
+  } // evaluateAsNumber
+
+  string_type evaluateAsString(const DOM::Node<string_type, string_adaptor>& context,
+                               const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    Registers r;
+    run(r, context, executionContext);
+    switch(type_)
+    {
+      case BOOL: return BoolValue<string_type, string_adaptor>(r.bools[result_]).asString();
+      case NUMBER: return NumericValue<string_type, string_adaptor>(r.numbers[result_]).asString();
+      default: return *r.strings[result_];
+    } // switch
+  } // evaluateAsString
+
+private:
+  enum Opcode
+  {
+    NUMBER_CONSTANT, BOOL_CONSTANT, STRING_CONSTANT,
+    CONTEXT_STRING, ATTRIBUTE_VALUE, POSITION, LAST,
+    LEAF_NUMBER, LEAF_BOOL, LEAF_STRING,
+    STRING_TO_NUMBER, BOOL_TO_NUMBER, NUMBER_TO_BOOL, STRING_TO_BOOL, NUMBER_TO_STRING, BOOL_TO_STRING,
+    ADD, SUBTRACT, MULTIPLY, DIVIDE, MODULUS, NEGATE, FLOOR, CEILING, ROUND,
+    NUMBER_EQUALS, NUMBER_NOT_EQUALS, LESS_THAN, LESS_THAN_EQUALS, GREATER_THAN, GREATER_THAN_EQUALS,
+    STRING_EQUALS, STRING_NOT_EQUALS, BOOL_EQUALS, BOOL_NOT_EQUALS,
+    NOT, AND, MOVE_BOOL, JUMP_IF_TRUE, JUMP_IF_FALSE,
+    CONCAT, APPEND, CONTAINS, STARTS_WITH, STRING_LENGTH
+  }; // Opcode
+
+  // dst, lhs and rhs are registers, operand is a constant, leaf, or jump target
+  struct Instruction
+  {
+    Instruction(Opcode o, int d, int l, int r, size_t a) :
+      op(o), dst(static_cast<unsigned char>(d)), lhs(static_cast<unsigned char>(l)), rhs(static_cast<unsigned char>(r)), operand(a) { }
+
+    Opcode op;
+    unsigned char dst;
+    unsigned char lhs;
+    unsigned char rhs;
+    size_t operand;
+  }; // struct Instruction
+
+  enum { MaxRegisters = 16, MaxStrings = 8 };
+
+  // a string register points at a constant, at a node's own text, or at
+  // its slot in store
+  struct Registers
+  {
+    double numbers[MaxRegisters];
+    bool bools[MaxRegisters];
+    const string_type* strings[MaxStrings];
+    string_type store[MaxStrings];
+  }; // struct Registers
+
+  class TooComplex { };
+
+  /////////////////////////////////////////////////////////
+  // compiling
+  void compile(const ExpressionT* expr)
+  {
+    ValueType type = expr->type();
+    if(((type != BOOL) && (type != NUMBER) && (type != STRING)) ||
+       (dynamic_cast<const ConstantValue<string_type, string_adaptor>*>(expr) != 0))
+      return;
+
+    nextRegister_[NUMBER] = nextRegister_[BOOL] = nextRegister_[STRING] = 0;
+    try {
+      result_ = lower(expr, type);
+    } // try
+    catch(const TooComplex&)
+    {
+      code_.clear();
+      return;
+    } // catch
+
+    // a single operation around leaves and constants is just the tree 
+    // with extra steps
+    size_t operations = 0;
+    for(typename std::vector<Instruction>::const_iterator i = code_.begin(), ie = code_.end(); i != ie; ++i)
+      if((i->op > STRING_CONSTANT) && ((i->op < LEAF_NUMBER) || (i->op > LEAF_STRING)))
+        ++operations;
+    if(operations < 2)
+      code_.clear();
+    type_ = type;
+  } // compile
+
+  int allocate(ValueType type)
+  {
+    int limit = (type == STRING) ? MaxStrings : MaxRegisters;
+    if(nextRegister_[type] == limit)
+      throw TooComplex();
+    return nextRegister_[type]++;
+  } // allocate
+
+  int emit(Opcode op, ValueType type, int lhs = 0, int rhs = 0, size_t operand = 0)
+  {
+    int dst = allocate(type);
+    code_.push_back(Instruction(op, dst, lhs, rhs, operand));
+    return dst;
+  } // emit
+
+  size_t addLeaf(const ExpressionT* expr)
+  {
+    leaves_.push_back(expr);
+    return leaves_.size() - 1;
+  } // addLeaf
+
+  size_t addString(const string_type& str)
+  {
+    strings_.push_back(str);
+    return strings_.size() - 1;
+  } // addString
+
+  // Lowers expr, converted to type, returning the register the result
+  // ends up in.  Registers are handed out stack fashion - once an
+  // instruction has consumed its operands, they're free again.
+  int lower(const ExpressionT* expr, ValueType type)
+  {
+    int present;
+    int reg = lowerOperand(expr, type, present);
+    if((present != -1) && (type != BOOL))
+      release(BOOL, present);
+    return reg;
+  } // lower
+
+  // as lower, but @name is allowed to be missing - present is the boolean
+  // register saying whether it was found, or -1 if expr is always there
+  int lowerOperand(const ExpressionT* expr, ValueType type, int& present)
+  {
+    present = -1;
+
+    if(const ConstantValue<string_type, string_adaptor>* constant = dynamic_cast<const ConstantValue<string_type, string_adaptor>*>(expr))
+    {
+      if(type == NUMBER)
+      {
+        numbers_.push_back(constant->value().asNumber());
+        return emit(NUMBER_CONSTANT, NUMBER, 0, 0, numbers_.size() - 1);
+      } // if ...
+      if(type == BOOL)
+        return emit(BOOL_CONSTANT, BOOL, 0, 0, constant->value().asBool());
+      return emit(STRING_CONSTANT, STRING, 0, 0, addString(constant->value().asString()));
+    } // if ...
+
+    string_type attribute;
+    if(isContextNode(expr))
+    {
+      if(type == BOOL)
+        return emit(BOOL_CONSTANT, BOOL, 0, 0, true);
+      return convert(emit(CONTEXT_STRING, STRING), STRING, type);
+    } // if ...
+    if(isAttribute(expr, attribute))
+    {
+      present = allocate(BOOL);
+      int value = emit(ATTRIBUTE_VALUE, STRING, present, 0, addString(attribute));
+      if(type == BOOL)
+      {
+        // only the flag is wanted, so the value's register is free again
+        release(STRING, value);
+        return present;
+      } // if ...
+      return convert(value, STRING, type);
+    } // if ...
+
+    const size_t start = code_.size();
+    int saved[3] = { nextRegister_[NUMBER], nextRegister_[BOOL], nextRegister_[STRING] };
+    ValueType natural = expr->type();
+    int reg = lowerNatural(expr, natural);
+    if(reg != -1)
+      return convert(reg, natural, type);
+
+    // couldn't be lowered - throw away anything lowerNatural started on
+    code_.erase(code_.begin() + start, code_.end());
+    nextRegister_[NUMBER] = saved[0]; nextRegister_[BOOL] = saved[1]; nextRegister_[STRING] = saved[2];
+    Opcode leaf = (type == NUMBER) ? LEAF_NUMBER : ((type == BOOL) ? LEAF_BOOL : LEAF_STRING);
+    return emit(leaf, type, 0, 0, addLeaf(expr));
+  } // lowerOperand
+
+  int convert(int reg, ValueType from, ValueType to)
+  {
+    if(from == to)
+      return reg;
+    release(from, reg);
+    switch(to)
+    {
+      case NUMBER: return emit((from == STRING) ? STRING_TO_NUMBER : BOOL_TO_NUMBER, NUMBER, reg);
+      case BOOL: return emit((from == STRING) ? STRING_TO_BOOL : NUMBER_TO_BOOL, BOOL, reg);
+      default: return emit((from == NUMBER) ? NUMBER_TO_STRING : BOOL_TO_STRING, STRING, reg);
+    } // switch
+  } // convert
+
+  void release(ValueType type, int reg)
+  {
+    nextRegister_[type] = reg;
+  } // release
+
+  // the expression in its own type, or -1 if it isn't something this knows about
+  int lowerNatural(const ExpressionT* expr, ValueType natural)
+  {
+    if(const RelationalOperator<string_type, string_adaptor>* op = dynamic_cast<const RelationalOperator<string_type, string_adaptor>*>(expr))
+      return lowerComparison(op);
+    if(const OrOperator<string_type, string_adaptor>* op = dynamic_cast<const OrOperator<string_type, string_adaptor>*>(expr))
+      return lowerLogical(op, JUMP_IF_TRUE);
+    if(const AndOperator<string_type, string_adaptor>* op = dynamic_cast<const AndOperator<string_type, string_adaptor>*>(expr))
+      return lowerLogical(op, JUMP_IF_FALSE);
+    if(const UnaryNegative<string_type, string_adaptor>* op = dynamic_cast<const UnaryNegative<string_type, string_adaptor>*>(expr))
+      return unary(NEGATE, NUMBER, op->expr(), NUMBER);
+    if(dynamic_cast<const PlusOperator<string_type, string_adaptor>*>(expr))
+      return arithmetic(ADD, expr);
+    if(dynamic_cast<const MinusOperator<string_type, string_adaptor>*>(expr))
+      return arithmetic(SUBTRACT, expr);
+    if(dynamic_cast<const MultiplyOperator<string_type, string_adaptor>*>(expr))
+      return arithmetic(MULTIPLY, expr);
+    if(dynamic_cast<const DivideOperator<string_type, string_adaptor>*>(expr))
+      return arithmetic(DIVIDE, expr);
+    if(dynamic_cast<const ModOperator<string_type, string_adaptor>*>(expr))
+      return arithmetic(MODULUS, expr);
+    if(const FunctionHolder<string_type, string_adaptor>* fn = dynamic_cast<const FunctionHolder<string_type, string_adaptor>*>(expr))
+      return lowerFunction(fn, natural);
+    return -1;
+  } // lowerNatural
+
+  int arithmetic(Opcode op, const ExpressionT* expr)
+  {
+    const BinaryExpression<string_type, string_adaptor>* binary = dynamic_cast<const BinaryExpression<string_type, string_adaptor>*>(expr);
+    return binaryOp(op, NUMBER, binary->lhs(), binary->rhs(), NUMBER);
+  } // arithmetic
+
+  int unary(Opcode op, ValueType resultType, const ExpressionT* operand, ValueType operandType)
+  {
+    int reg = lower(operand, operandType);
+    release(operandType, reg);
+    return emit(op, resultType, reg);
+  } // unary
+
+  int binaryOp(Opcode op, ValueType resultType, const ExpressionT* lhs, const ExpressionT* rhs, ValueType operandType)
+  {
+    int l = lower(lhs, operandType);
+    int r = lower(rhs, operandType);
+    release(operandType, l);
+    return emit(op, resultType, l, r);
+  } // binaryOp
+
+  int lowerLogical(const BinaryExpression<string_type, string_adaptor>* op, Opcode shortCircuit)
+  {
+    int result = allocate(BOOL);
+    int l = lower(op->lhs(), BOOL);
+    code_.push_back(Instruction(MOVE_BOOL, result, l, 0, 0));
+    release(BOOL, l);
+    size_t jump = code_.size();
+    code_.push_back(Instruction(shortCircuit, 0, result, 0, 0));
+    int r = lower(op->rhs(), BOOL);
+    code_.push_back(Instruction(MOVE_BOOL, result, r, 0, 0));
+    release(BOOL, r);
+    code_[jump].operand = code_.size();
+    return result;
+  } // lowerLogical
+
+  // The same rules RelationalOperator works by, except that . and @name,
+  // being at most one node, compare as that node's string-value would.
+  int lowerComparison(const BinaryExpression<string_type, string_adaptor>* op)
+  {
+    const ExpressionT* lhs = op->lhs();
+    const ExpressionT* rhs = op->rhs();
+    bool equality = (dynamic_cast<const EqualsOperator<string_type, string_adaptor>*>(op) != 0) ||
+                    (dynamic_cast<const NotEqualsOperator<string_type, string_adaptor>*>(op) != 0);
+
+    ValueType lt = operandType(lhs);
+    ValueType rt = operandType(rhs);
+    if((lt == ANY) || (rt == ANY) ||
+       ((lt == NODE_SET) && (rt == BOOL)) || ((lt == BOOL) && (rt == NODE_SET)))
+      return -1;
+
+    ValueType compareAs = NUMBER;
+    if(equality)
+    {
+      if((lt == BOOL) || (rt == BOOL))
+        compareAs = BOOL;
+      else if((lt != NUMBER) && (rt != NUMBER))
+        compareAs = STRING;
+    } // if ...
+
+    int result = allocate(BOOL);
+    int lp, rp;
+    int l = lowerOperand(lhs, compareAs, lp);
+    int r = lowerOperand(rhs, compareAs, rp);
+    code_.push_back(Instruction(comparison(op, compareAs), result, l, r, 0));
+    // a missing attribute compares false whatever the operator
+    if(lp != -1)
+      code_.push_back(Instruction(AND, result, result, lp, 0));
+    if(rp != -1)
+      code_.push_back(Instruction(AND, result, result, rp, 0));
+    release(compareAs, l);
+    release(BOOL, result + 1);
+    return result;
+  } // lowerComparison
+
+  // NODE_SET here means . or @name
+  ValueType operandType(const ExpressionT* expr) const
+  {
+    string_type attribute;
+    if(isContextNode(expr) || isAttribute(expr, attribute))
+      return NODE_SET;
+    ValueType type = expr->type();
+    return (type == NODE_SET) ? ANY : type;
+  } // operandType
+
+  Opcode comparison(const BinaryExpression<string_type, string_adaptor>* op, ValueType compareAs) const
+  {
+    bool notEquals = (dynamic_cast<const NotEqualsOperator<string_type, string_adaptor>*>(op) != 0);
+    if(notEquals || (dynamic_cast<const EqualsOperator<string_type, string_adaptor>*>(op) != 0))
+    {
+      switch(compareAs)
+      {
+        case BOOL: return notEquals ? BOOL_NOT_EQUALS : BOOL_EQUALS;
+        case STRING: return notEquals ? STRING_NOT_EQUALS : STRING_EQUALS;
+        default: return notEquals ? NUMBER_NOT_EQUALS : NUMBER_EQUALS;
+      } // switch
+    } // if ...
+    if(dynamic_cast<const LessThanOperator<string_type, string_adaptor>*>(op))
+      return LESS_THAN;
+    if(dynamic_cast<const LessThanEqualsOperator<string_type, string_adaptor>*>(op))
+      return LESS_THAN_EQUALS;
+    if(dynamic_cast<const GreaterThanOperator<string_type, string_adaptor>*>(op))
+      return GREATER_THAN;
+    return GREATER_THAN_EQUALS;
+  } // comparison
+
+  // Core functions are always bound ahead of any resolver, so an
+  // unprefixed name is enough to know which function this is.
+  int lowerFunction(const FunctionHolder<string_type, string_adaptor>* fn, ValueType natural)
+  {
+    if(!string_adaptor::empty(fn->namespace_uri()))
+      return -1;
+
+    const std::vector<XPathExpression<string_type, string_adaptor> >& args = fn->args();
+    const std::string name = string_adaptor::asStdString(fn->name());
+    if(name == "position")
+      return emit(POSITION, NUMBER);
+    if(name == "last")
+      return emit(LAST, NUMBER);
+    if(name == "true")
+      return emit(BOOL_CONSTANT, BOOL, 0, 0, true);
+    if(name == "false")
+      return emit(BOOL_CONSTANT, BOOL, 0, 0, false);
+    if(name == "not")
+      return unary(NOT, BOOL, args[0].get(), BOOL);
+    if(name == "boolean")
+      return lower(args[0].get(), BOOL);
+    if(name == "floor")
+      return unary(FLOOR, NUMBER, args[0].get(), NUMBER);
+    if(name == "ceiling")
+      return unary(CEILING, NUMBER, args[0].get(), NUMBER);
+    if(name == "round")
+      return unary(ROUND, NUMBER, args[0].get(), NUMBER);
+    if((name == "number") || (name == "string"))
+      return args.empty() ? convert(emit(CONTEXT_STRING, STRING), STRING, natural) : lower(args[0].get(), natural);
+    if(name == "string-length")
+    {
+      int str = args.empty() ? emit(CONTEXT_STRING, STRING) : lower(args[0].get(), STRING);
+      release(STRING, str);
+      return emit(STRING_LENGTH, NUMBER, str);
+    } // if ...
+    if(name == "contains")
+      return binaryOp(CONTAINS, BOOL, args[0].get(), args[1].get(), STRING);
+    if(name == "starts-with")
+      return binaryOp(STARTS_WITH, BOOL, args[0].get(), args[1].get(), STRING);
+    if(name == "concat")
+    {
+      int result = allocate(STRING);
+      int l = lower(args[0].get(), STRING);
+      int r = lower(args[1].get(), STRING);
+      code_.push_back(Instruction(CONCAT, result, l, r, 0));
+      for(size_t a = 2; a != args.size(); ++a)
+      {
+        release(STRING, l);
+        r = lower(args[a].get(), STRING);
+        code_.push_back(Instruction(APPEND, result, r, 0, 0));
+      } // for ...
+      release(STRING, l);
+      return result;
+    } // if ...
+    return -1;
+  } // lowerFunction
+
+  // .
+  static bool isContextNode(const ExpressionT* expr)
+  {
+    const TestStepExpression<string_type, string_adaptor>* step = singleStep(expr);
+    return (step != 0) && (step->axis() == SELF) &&
+           (dynamic_cast<const AnyNodeTest<string_type, string_adaptor>*>(step->test()) != 0);
+  } // isContextNode
+
+  // @name, for an attribute in no namespace
+  static bool isAttribute(const ExpressionT* expr, string_type& attribute)
+  {
+    const TestStepExpression<string_type, string_adaptor>* step = singleStep(expr);
+    if((step == 0) || (step->axis() != ATTRIBUTE))
+      return false;
+    const AttributeNameNodeTest<string_type, string_adaptor>* test = dynamic_cast<const AttributeNameNodeTest<string_type, string_adaptor>*>(step->test());
+    if(test == 0)
+      return false;
+    attribute = test->name();
+    return true;
+  } // isAttribute
+
+  static const TestStepExpression<string_type, string_adaptor>* singleStep(const ExpressionT* expr)
+  {
+    const RelativeLocationPath<string_type, string_adaptor>* path = dynamic_cast<const RelativeLocationPath<string_type, string_adaptor>*>(expr);
+    if((path == 0) || (path->steps().size() != 1) ||
+       (dynamic_cast<const AbsoluteLocationPath<string_type, string_adaptor>*>(expr) != 0))
+      return 0;
+    const TestStepExpression<string_type, string_adaptor>* step = dynamic_cast<const TestStepExpression<string_type, string_adaptor>*>(path->steps()[0]);
+    return ((step != 0) && !step->has_predicates()) ? step : 0;
+  } // singleStep
+
+  /////////////////////////////////////////////////////////
+  // running
+  void run(Registers& r,
+           const DOM::Node<string_type, string_adaptor>& context,
+           const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    const Instruction* const begin = &code_[0];
+    const Instruction* const end = begin + code_.size();
+    for(const Instruction* i = begin; i != end; ++i)
+    {
+      switch(i->op)
+      {
+        case NUMBER_CONSTANT: r.numbers[i->dst] = numbers_[i->operand]; break;
+        case BOOL_CONSTANT: r.bools[i->dst] = (i->operand != 0); break;
+        case STRING_CONSTANT: r.strings[i->dst] = &strings_[i->operand]; break;
+        case CONTEXT_STRING: r.strings[i->dst] = stringValue(context, r.store[i->dst]); break;
+        case ATTRIBUTE_VALUE: r.bools[i->lhs] = attributeValue(context, strings_[i->operand], r.strings[i->dst]); break;
+        case POSITION: r.numbers[i->dst] = executionContext.position(); break;
+        case LAST: r.numbers[i->dst] = executionContext.last(); break;
+
+        case LEAF_NUMBER: r.numbers[i->dst] = leaves_[i->operand]->evaluateAsNumber(context, executionContext); break;
+        case LEAF_BOOL: r.bools[i->dst] = leaves_[i->operand]->evaluateAsBool(context, executionContext); break;
+        case LEAF_STRING:
+          r.store[i->dst] = leaves_[i->operand]->evaluateAsString(context, executionContext);
+          r.strings[i->dst] = &r.store[i->dst];
+          break;
+
+        case STRING_TO_NUMBER: r.numbers[i->dst] = stringAsNumber<string_type, string_adaptor>(*r.strings[i->lhs]); break;
+        case BOOL_TO_NUMBER: r.numbers[i->dst] = r.bools[i->lhs] ? 1 : 0; break;
+        case NUMBER_TO_BOOL: r.bools[i->dst] = NumericValue<string_type, string_adaptor>(r.numbers[i->lhs]).asBool(); break;
+        case STRING_TO_BOOL: r.bools[i->dst] = !string_adaptor::empty(*r.strings[i->lhs]); break;
+        case NUMBER_TO_STRING:
+          r.store[i->dst] = NumericValue<string_type, string_adaptor>(r.numbers[i->lhs]).asString();
+          r.strings[i->dst] = &r.store[i->dst];
+          break;
+        case BOOL_TO_STRING:
+          r.store[i->dst] = BoolValue<string_type, string_adaptor>(r.bools[i->lhs]).asString();
+          r.strings[i->dst] = &r.store[i->dst];
+          break;
+
+        case ADD: r.numbers[i->dst] = r.numbers[i->lhs] + r.numbers[i->rhs]; break;
+        case SUBTRACT: r.numbers[i->dst] = r.numbers[i->lhs] - r.numbers[i->rhs]; break;
+        case MULTIPLY: r.numbers[i->dst] = r.numbers[i->lhs] * r.numbers[i->rhs]; break;
+        case DIVIDE: r.numbers[i->dst] = r.numbers[i->lhs] / r.numbers[i->rhs]; break;
+        case MODULUS: r.numbers[i->dst] = NaN_aware_modulus()(r.numbers[i->lhs], r.numbers[i->rhs]); break;
+        case NEGATE: r.numbers[i->dst] = -r.numbers[i->lhs]; break;
+        case FLOOR: r.numbers[i->dst] = std::floor(r.numbers[i->lhs]); break;
+        case CEILING: r.numbers[i->dst] = std::ceil(r.numbers[i->lhs]); break;
+        case ROUND: r.numbers[i->dst] = roundNumber(r.numbers[i->lhs]); break;
+
+        case NUMBER_EQUALS: r.bools[i->dst] = r.numbers[i->lhs] == r.numbers[i->rhs]; break;
+        case NUMBER_NOT_EQUALS: r.bools[i->dst] = r.numbers[i->lhs] != r.numbers[i->rhs]; break;
+        case LESS_THAN: r.bools[i->dst] = r.numbers[i->lhs] < r.numbers[i->rhs]; break;
+        case LESS_THAN_EQUALS: r.bools[i->dst] = r.numbers[i->lhs] <= r.numbers[i->rhs]; break;
+        case GREATER_THAN: r.bools[i->dst] = r.numbers[i->lhs] > r.numbers[i->rhs]; break;
+        case GREATER_THAN_EQUALS: r.bools[i->dst] = r.numbers[i->lhs] >= r.numbers[i->rhs]; break;
+        case STRING_EQUALS: r.bools[i->dst] = *r.strings[i->lhs] == *r.strings[i->rhs]; break;
+        case STRING_NOT_EQUALS: r.bools[i->dst] = !(*r.strings[i->lhs] == *r.strings[i->rhs]); break;
+        case BOOL_EQUALS: r.bools[i->dst] = r.bools[i->lhs] == r.bools[i->rhs]; break;
+        case BOOL_NOT_EQUALS: r.bools[i->dst] = r.bools[i->lhs] != r.bools[i->rhs]; break;
+
+        case NOT: r.bools[i->dst] = !r.bools[i->lhs]; break;
+        case AND: r.bools[i->dst] = r.bools[i->lhs] && r.bools[i->rhs]; break;
+        case MOVE_BOOL: r.bools[i->dst] = r.bools[i->lhs]; break;
+        case JUMP_IF_TRUE: if(r.bools[i->lhs]) i = begin + i->operand - 1; break;
+        case JUMP_IF_FALSE: if(!r.bools[i->lhs]) i = begin + i->operand - 1; break;
+
+        case CONCAT:
+          r.store[i->dst] = *r.strings[i->lhs];
+          string_adaptor::append(r.store[i->dst], *r.strings[i->rhs]);
+          r.strings[i->dst] = &r.store[i->dst];
+          break;
+        case APPEND: string_adaptor::append(r.store[i->dst], *r.strings[i->lhs]); break;
+        case CONTAINS: r.bools[i->dst] = string_adaptor::find(*r.strings[i->lhs], *r.strings[i->rhs]) != string_adaptor::npos(); break;
+        case STARTS_WITH: r.bools[i->dst] = startsWith(*r.strings[i->lhs], *r.strings[i->rhs]); break;
+        case STRING_LENGTH: r.numbers[i->dst] = static_cast<double>(string_adaptor::length(*r.strings[i->lhs])); break;
+      } // switch
+    } // for ...
+  } // run
+
+  // the string-value, pointing straight at the node's text where it can
+  static const string_type* stringValue(const DOM::Node<string_type, string_adaptor>& node, string_type& store)
+  {
+    const DOM::Node_impl<string_type, string_adaptor>* impl = node.underlying_impl();
+    switch(node.getNodeType())
+    {
+      case DOM::Node_base::ELEMENT_NODE:
+        {
+          const DOM::Node_impl<string_type, string_adaptor>* first = impl->getFirstChild();
+          if((first != 0) && (first->getNextSibling() == 0) && nodeIsText<string_type, string_adaptor>(first))
+            return &first->getNodeValue();
+        } // case
+        break;
+      case DOM::Node_base::ATTRIBUTE_NODE:
+      case DOM::Node_base::PROCESSING_INSTRUCTION_NODE:
+      case DOM::Node_base::COMMENT_NODE:
+      case NAMESPACE_NODE_TYPE:
+        return &impl->getNodeValue();
+    } // switch
+
+    store = nodeStringValue<string_type, string_adaptor>(node);
+    return &store;
+  } // stringValue
+
+  static bool attributeValue(const DOM::Node<string_type, string_adaptor>& node,
+                             const string_type& name,
+                             const string_type*& value)
+  {
+    static const string_type empty;
+    value = &empty;
+
+    const DOM::Node_impl<string_type, string_adaptor>* impl = node.underlying_impl();
+    if(!impl->hasAttributes())
+      return false;
+
+    const DOM::NamedNodeMap_impl<string_type, string_adaptor>* attrs = impl->getAttributes();
+    for(unsigned int a = 0, ae = attrs->getLength(); a != ae; ++a)
+    {
+      const DOM::Node_impl<string_type, string_adaptor>* attr = attrs->item(a);
+      if((attr->getNodeName() == name) && string_adaptor::empty(attr->getNamespaceURI()))
+      {
+        value = &attr->getNodeValue();
+        return true;
+      } // if ...
+    } // for ...
+    return false;
+  } // attributeValue
+
+  static bool startsWith(const string_type& value, const string_type& start)
+  {
+    if(string_adaptor::length(value) < string_adaptor::length(start))
+      return false;
+
+    typename string_adaptor::const_iterator i = string_adaptor::begin(value);
+    typename string_adaptor::const_iterator s = string_adaptor::begin(start);
+    typename string_adaptor::const_iterator e = string_adaptor::end(start);
+    for(; s != e; ++s, ++i)
+      if(*i != *s)
+        return false;
+    return true;
+  } // startsWith
+
+  std::vector<Instruction> code_;
+  std::vector<double> numbers_;
+  std::vector<string_type> strings_;
+  std::vector<const ExpressionT*> leaves_;
+  ValueType type_;
+  int result_;
+  int nextRegister_[NODE_SET];
+}; // class Bytecode
+
+// The root of a compiled expression, run as Bytecode where that's possible.
+// It owns the tree, which still answers for anything the Bytecode can't.
+template<class string_type, class string_adaptor>
+class BytecodeExpression : public XPathExpression_impl<string_type, string_adaptor>
+{
+public:
+  // returns expr itself if it isn't worth lowering
+  static XPathExpression_impl<string_type, string_adaptor>* create(XPathExpression_impl<string_type, string_adaptor>* expr)
+  {
+    Bytecode<string_type, string_adaptor> code(expr);
+    if(!code.compiled())
+      return expr;
+    return new BytecodeExpression(expr, code);
+  } // create
+
+  virtual ~BytecodeExpression()
+  {
+    delete tree_;
+  } // ~BytecodeExpression
+
+  const XPathExpression_impl<string_type, string_adaptor>* tree() const { return tree_; }
+
+  virtual ValueType type() const { return tree_->type(); }
+
+  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context,
+                                                           const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    switch(tree_->type())
+    {
+      case BOOL: return BoolValue<string_type, string_adaptor>::createValue(code_.evaluateAsBool(context, executionContext));
+      case NUMBER: return NumericValue<string_type, string_adaptor>::createValue(code_.evaluateAsNumber(context, executionContext));
+      default: return StringValue<string_type, string_adaptor>::createValue(code_.evaluateAsString(context, executionContext));
+    } // switch
+  } // evaluate
+
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context,
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return code_.evaluateAsBool(context, executionContext);
+  } // evaluateAsBool
+
+  virtual double evaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context,
+                                  const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return code_.evaluateAsNumber(context, executionContext);
+  } // evaluateAsNumber
+
+  virtual string_type evaluateAsString(const DOM::Node<string_type, string_adaptor>& context,
+                                       const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return code_.evaluateAsString(context, executionContext);
+  } // evaluateAsString
+
+  virtual void scan(Expression_scanner<string_type, string_adaptor>& scanner) const { tree_->scan(scanner); }
+
+private:
+  BytecodeExpression(XPathExpression_impl<string_type, string_adaptor>* tree,
+                     const Bytecode<string_type, string_adaptor>& code) :
+    tree_(tree),
+    code_(code)
+  {
+  } // BytecodeExpression
+
+  XPathExpression_impl<string_type, string_adaptor>* tree_;
+  const Bytecode<string_type, string_adaptor> code_;
+}; // class BytecodeExpression
+
+} // namespace impl
+} // namespace XPath
+} // namespace Arabica
+
+#endif
@@ -33,8 +33,34 @@ private:
   Expression_scanner& operator=(const Expression_scanner&);
 }; // class Expression_scanner
 
+// Takes the nodes of a node-set one at a time, as XPathExpression_impl::stream
+// produces them.  Returning false from visit ends the stream.  A visitor 
+// that doesn't care about order - count(), say - can take nodes as the axes
+// produce them, saving a sort.
+template<class string_type, class string_adaptor>
+class NodeVisitor
+{
+protected:
+  NodeVisitor() { }
+  NodeVisitor(const NodeVisitor&) { }
+  ~NodeVisitor() { }
+
+public:
+  virtual bool visit(const DOM::Node<string_type, string_adaptor>& node) = 0;
+  virtual bool needsDocumentOrder() const { return true; }
+
+private:
+  bool operator==(const NodeVisitor&) const;
+  NodeVisitor& operator=(const NodeVisitor&);
+}; // class NodeVisitor
+
 } // namespace impl
 
+// A compiled expression is immutable once the parser has built it, so one
+// instance can be evaluated from several threads at once, provided each
+// thread works on its own documents.  Everything that changes during an
+// evaluation - context position and size, variable bindings - lives in the
+// ExecutionContext, which belongs to the caller.
 template<class string_type, class string_adaptor>
 class XPathExpression_impl
 {
@@ -48,23 +74,28 @@ public:
 
   XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context) const
   {
-    return evaluate(context, StaticExecutionContext());
+    ExecutionContext<string_type, string_adaptor> executionContext;
+    return evaluate(context, executionContext);
   } // evaluate
   virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context) const 
   { 
-    return evaluateAsBool(context, StaticExecutionContext()); 
+    ExecutionContext<string_type, string_adaptor> executionContext;
+    return evaluateAsBool(context, executionContext); 
   }
   virtual double evaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context) const 
   { 
-    return evaluateAsNumber(context, StaticExecutionContext()); 
+    ExecutionContext<string_type, string_adaptor> executionContext;
+    return evaluateAsNumber(context, executionContext); 
   }
   virtual string_type evaluateAsString(const DOM::Node<string_type, string_adaptor>& context) const 
   { 
-    return evaluateAsString(context, StaticExecutionContext()); 
+    ExecutionContext<string_type, string_adaptor> executionContext;
+    return evaluateAsString(context, executionContext); 
   }
   virtual NodeSet<string_type, string_adaptor> evaluateAsNodeSet(const DOM::Node<string_type, string_adaptor>& context) const 
   { 
-    return evaluateAsNodeSet(context, StaticExecutionContext()); 
+    ExecutionContext<string_type, string_adaptor> executionContext;
+    return evaluateAsNodeSet(context, executionContext); 
   }
 
   virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
@@ -91,15 +122,23 @@ public:
     return evaluate(context, executionContext).asNodeSet(); 
   }
 
+  // Passes each node of the resulting node-set to visitor, returning false
+  // if the visitor stopped early.  Location paths override this to hand 
+  // nodes over as they are found, without building the node-set.
+  virtual bool stream(const DOM::Node<string_type, string_adaptor>& context, 
+                      const ExecutionContext<string_type, string_adaptor>& executionContext,
+                      impl::NodeVisitor<string_type, string_adaptor>& visitor) const
+  {
+    NodeSet<string_type, string_adaptor> nodes = evaluateAsNodeSet(context, executionContext);
+    for(typename NodeSet<string_type, string_adaptor>::const_iterator n = nodes.begin(), ne = nodes.end(); n != ne; ++n)
+      if(!visitor.visit(*n))
+        return false;
+    return true;
+  } // stream
+
   virtual void scan(impl::Expression_scanner<string_type, string_adaptor>& scanner) const { scanner.scan(this); }
 
 private:
-  static const ExecutionContext<string_type, string_adaptor>& StaticExecutionContext() 
-  {
-    static ExecutionContext<string_type, string_adaptor> executionContext;
-    return executionContext;
-  } // StaticExecutionContext
-
   XPathExpression_impl(const XPathExpression_impl&);
   bool operator==(const XPathExpression_impl&);
   XPathExpression_impl& operator=(const XPathExpression_impl&);
@@ -237,14 +276,14 @@ public:
     scanner.scan(this);
   } // scan
 
+  XPathExpression_impl<string_type, string_adaptor>* expr() const { return expr_; }
+
 protected:
   ~UnaryExpression() 
   {
     delete expr_;
   } // ~UnaryExpression
 
-  XPathExpression_impl<string_type, string_adaptor>* expr() const { return expr_; }
-
 private:
   XPathExpression_impl<string_type, string_adaptor>* expr_;
 }; // class UnaryExpression
@@ -267,6 +306,9 @@ public:
     scanner.scan(this);
   } // scan
 
+  XPathExpression_impl<string_type, string_adaptor>* lhs() const { return lhs_; }
+  XPathExpression_impl<string_type, string_adaptor>* rhs() const { return rhs_; }
+
 protected:
   ~BinaryExpression() 
   { 
@@ -274,9 +316,6 @@ protected:
     delete rhs_;
   } // ~BinaryExpression
 
-  XPathExpression_impl<string_type, string_adaptor>* lhs() const { return lhs_; }
-  XPathExpression_impl<string_type, string_adaptor>* rhs() const { return rhs_; }
-
 private:
   XPathExpression_impl<string_type, string_adaptor>* lhs_;
   XPathExpression_impl<string_type, string_adaptor>* rhs_;
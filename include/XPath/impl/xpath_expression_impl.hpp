@@ -30,6 +30,18 @@ public:
     return doEvaluateAsNumber(context, executionContext); 
   } // evaluateAsNumber 
 
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context, 
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const 
+  { 
+    return NumericValue<string_type, string_adaptor>(doEvaluateAsNumber(context, executionContext)).asBool(); 
+  } // evaluateAsBool 
+
+  virtual string_type evaluateAsString(const DOM::Node<string_type, string_adaptor>& context, 
+                                       const ExecutionContext<string_type, string_adaptor>& executionContext) const 
+  { 
+    return NumericValue<string_type, string_adaptor>(doEvaluateAsNumber(context, executionContext)).asString(); 
+  } // evaluateAsString 
+
 protected:
   virtual double doEvaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context, 
                                   const ExecutionContext<string_type, string_adaptor>& executionContext) const = 0;
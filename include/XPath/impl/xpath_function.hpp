@@ -3,6 +3,9 @@
 
 #include <cmath>
 #include <regex>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 #include <boost/shared_ptr.hpp>
 #include <XML/XMLCharacterClasses.hpp>
 #include <text/UnicodeCharacters.hpp>
@@ -35,6 +38,25 @@ public:
   virtual XPathValue_impl<string_type, string_adaptor>* evaluate(const DOM::Node<string_type, string_adaptor>& context,
                                             const ExecutionContext<string_type, string_adaptor>& executionContext) const = 0;
 
+  // the typed base classes below override these to skip the XPathValue
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context,
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return XPathValue<string_type, string_adaptor>(evaluate(context, executionContext)).asBool();
+  } // evaluateAsBool
+
+  virtual double evaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context,
+                                  const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return XPathValue<string_type, string_adaptor>(evaluate(context, executionContext)).asNumber();
+  } // evaluateAsNumber
+
+  virtual string_type evaluateAsString(const DOM::Node<string_type, string_adaptor>& context,
+                                       const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return XPathValue<string_type, string_adaptor>(evaluate(context, executionContext)).asString();
+  } // evaluateAsString
+
 protected:
   size_t argCount() const { return args_.size(); }
 
@@ -73,6 +95,16 @@ protected:
     return args_[index].evaluateAsNodeSet(context, executionContext);
   } // argAsNodeSet
 
+  // hands the nodes of the argument to visitor without building the
+  // node-set, where the argument can manage that
+  bool argAsNodes(size_t index,
+                  const DOM::Node<string_type, string_adaptor>& context,
+                  const ExecutionContext<string_type, string_adaptor>& executionContext,
+                  impl::NodeVisitor<string_type, string_adaptor>& visitor) const
+  {
+    return args_[index].get()->stream(context, executionContext, visitor);
+  } // argAsNodes
+
 private:
   const std::vector<XPathExpression<string_type, string_adaptor> > args_;
 }; // class XPathFunction
@@ -92,6 +124,24 @@ public:
     return new BoolValue<string_type, string_adaptor>(doEvaluate(context, executionContext));
   } // evaluate
 
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context,
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return doEvaluate(context, executionContext);
+  } // evaluateAsBool
+
+  virtual double evaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context,
+                                  const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return doEvaluate(context, executionContext) ? 1 : 0;
+  } // evaluateAsNumber
+
+  virtual string_type evaluateAsString(const DOM::Node<string_type, string_adaptor>& context,
+                                       const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return BoolValue<string_type, string_adaptor>(doEvaluate(context, executionContext)).asString();
+  } // evaluateAsString
+
 protected:
   virtual bool doEvaluate(const DOM::Node<string_type, string_adaptor>& context,
                           const ExecutionContext<string_type, string_adaptor>& executionContext) const = 0;
@@ -112,6 +162,24 @@ public:
     return new NumericValue<string_type, string_adaptor>(doEvaluate(context, executionContext));
   } // evaluate
 
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context,
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return NumericValue<string_type, string_adaptor>(doEvaluate(context, executionContext)).asBool();
+  } // evaluateAsBool
+
+  virtual double evaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context,
+                                  const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return doEvaluate(context, executionContext);
+  } // evaluateAsNumber
+
+  virtual string_type evaluateAsString(const DOM::Node<string_type, string_adaptor>& context,
+                                       const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return NumericValue<string_type, string_adaptor>(doEvaluate(context, executionContext)).asString();
+  } // evaluateAsString
+
 protected:
   virtual double doEvaluate(const DOM::Node<string_type, string_adaptor>& context,
                             const ExecutionContext<string_type, string_adaptor>& executionContext) const = 0;
@@ -132,6 +200,24 @@ public:
     return new StringValue<string_type, string_adaptor>(doEvaluate(context, executionContext));
   } // evaluate
 
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context,
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return !string_adaptor::empty(doEvaluate(context, executionContext));
+  } // evaluateAsBool
+
+  virtual double evaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context,
+                                  const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return impl::stringAsNumber<string_type, string_adaptor>(doEvaluate(context, executionContext));
+  } // evaluateAsNumber
+
+  virtual string_type evaluateAsString(const DOM::Node<string_type, string_adaptor>& context,
+                                       const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return doEvaluate(context, executionContext);
+  } // evaluateAsString
+
 protected:
   virtual string_type doEvaluate(const DOM::Node<string_type, string_adaptor>& context,
                                  const ExecutionContext<string_type, string_adaptor>& executionContext) const = 0;
@@ -152,6 +238,12 @@ public:
     return new NodeSetValue<string_type, string_adaptor>(doEvaluate(context, executionContext));
   } // evaluate
 
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context,
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return !doEvaluate(context, executionContext).empty();
+  } // evaluateAsBool
+
 protected:
   virtual NodeSet<string_type, string_adaptor> doEvaluate(const DOM::Node<string_type, string_adaptor>& context,
                                                           const ExecutionContext<string_type, string_adaptor>& executionContext) const = 0;
@@ -203,8 +295,25 @@ public:
   virtual double doEvaluate(const DOM::Node<string_type, string_adaptor>& context,
                             const ExecutionContext<string_type, string_adaptor>& executionContext) const
   {
-    return baseT::argAsNodeSet(0, context, executionContext).size();
+    Counter counter;
+    baseT::argAsNodes(0, context, executionContext, counter);
+    return static_cast<double>(counter.count());
   } // evaluate
+
+private:
+  class Counter : public impl::NodeVisitor<string_type, string_adaptor>
+  {
+  public:
+    Counter() : count_(0) { }
+
+    virtual bool visit(const DOM::Node<string_type, string_adaptor>& /* node */) { ++count_; return true; }
+    virtual bool needsDocumentOrder() const { return false; }
+
+    size_t count() const { return count_; }
+
+  private:
+    size_t count_;
+  }; // class Counter
 }; // class CountFn
 
 // node-set id(object)
@@ -555,13 +664,93 @@ protected:
   } // evaluate
 }; // class TranslateFn
 
-// boolean matches(string, string)
+// A bounded most-recently-used cache of compiled regular expressions.
+// Entries are handed out as shared pointers, so one evicted while another 
+// thread is still matching against it stays alive until that match is done.
+template<class string_type, class string_adaptor>
+class RegexCache
+{
+public:
+  typedef std::basic_regex<typename string_adaptor::value_type> regex_type;
+  typedef boost::shared_ptr<const regex_type> regex_ptr;
+  typedef std::pair<string_type, string_type> key_type;
+
+  explicit RegexCache(size_t capacity) : capacity_(capacity) { }
+
+  regex_ptr find(const key_type& key) 
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    typename Index::iterator i = index_.find(key);
+    if(i == index_.end())
+      return regex_ptr();
+    entries_.splice(entries_.begin(), entries_, i->second);
+    return i->second->second;
+  } // find
+
+  void insert(const key_type& key, const regex_ptr& regex)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(index_.find(key) != index_.end())
+      return;
+    entries_.push_front(std::make_pair(key, regex));
+    index_[key] = entries_.begin();
+    if(entries_.size() > capacity_)
+    {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    } // if ...
+  } // insert
+
+private:
+  struct hashKey
+  {
+    size_t operator()(const key_type& key) const
+    {
+      hashStringValue<string_type, string_adaptor> hash;
+      return hash(key.first) * 31 + hash(key.second);
+    } // operator()
+  }; // struct hashKey
+
+  typedef std::list<std::pair<key_type, regex_ptr> > Entries;
+  typedef std::unordered_map<key_type, typename Entries::iterator, hashKey> Index;
+
+  const size_t capacity_;
+  Entries entries_;
+  Index index_;
+  std::mutex mutex_;
+
+  RegexCache(const RegexCache&);
+  RegexCache& operator=(const RegexCache&);
+}; // class RegexCache
+
+// boolean matches(string, string, string?)
+// A pattern and flags given as literals are compiled along with the rest of
+// the expression.  Patterns only known at run time are compiled on first
+// use and kept in a small cache.
 template<class string_type, class string_adaptor>
 class MatchesFn : public BooleanXPathFunction<string_type, string_adaptor>
 {
   typedef MatchesFn<string_type, string_adaptor> baseT;
+  typedef RegexCache<string_type, string_adaptor> CacheT;
+  typedef typename CacheT::regex_type regex_type;
+  typedef typename CacheT::regex_ptr regex_ptr;
 public:
-  MatchesFn(const std::vector<XPathExpression<string_type, string_adaptor> >& args) : BooleanXPathFunction<string_type, string_adaptor>(2, 3, args) { }
+  MatchesFn(const std::vector<XPathExpression<string_type, string_adaptor> >& args) : 
+      BooleanXPathFunction<string_type, string_adaptor>(2, 3, args),
+      cache_(CacheSize) 
+  { 
+    if(!isConstant(args[1]) || ((args.size() == 3) && !isConstant(args[2])))
+      return;
+
+    // a bad pattern is reported when the expression is evaluated, as it 
+    // would be if the pattern wasn't a literal
+    try {
+      const DOM::Node<string_type, string_adaptor> none;
+      regex_ = compile(args[1].evaluateAsString(none), 
+                       (args.size() == 3) ? args[2].evaluateAsString(none) : string_adaptor::empty_string());
+    } 
+    catch(const std::exception&) { }
+  } // MatchesFn
 
 protected:
   typedef typename string_adaptor::value_type flag_type;
@@ -569,12 +758,35 @@ protected:
                           const ExecutionContext<string_type, string_adaptor>& executionContext) const
   {
     const string_type& str = baseT::argAsString(0, context, executionContext);
-    std::wstring wide_pattern = string_adaptor::asStdWString(
-        baseT::argAsString(1, context, executionContext));
+    regex_ptr regex = regex_;
+    if(!regex)
+    {
+      typename CacheT::key_type key(baseT::argAsString(1, context, executionContext),
+                                    (baseT::argCount() == 3) ? baseT::argAsString(2, context, executionContext) : string_adaptor::empty_string());
+      regex = cache_.find(key);
+      if(!regex)
+      {
+        regex = compile(key.first, key.second);
+        cache_.insert(key, regex);
+      } // if ...
+    } // if ...
+    return std::regex_search(string_adaptor::begin(str), string_adaptor::end(str), *regex);
+  } // evaluate
+
+private:
+  static const size_t CacheSize = 16;
+
+  static bool isConstant(const XPathExpression<string_type, string_adaptor>& arg)
+  {
+    return dynamic_cast<const ConstantValue<string_type, string_adaptor>*>(arg.get()) != 0;
+  } // isConstant
+
+  static regex_ptr compile(const string_type& pattern_string, const string_type& flags_string)
+  {
+    std::wstring wide_pattern = string_adaptor::asStdWString(pattern_string);
     std::regex_constants::syntax_option_type regex_syntax = std::regex::ECMAScript;
-    if (baseT::argCount() == 3) {
-      const std::wstring &flags = string_adaptor::asStdWString(
-          baseT::argAsString(2, context, executionContext));
+    {
+      const std::wstring &flags = string_adaptor::asStdWString(flags_string);
       const wchar_t
           kIgnoreCaseMode       = L'i',
           kIgnoreSpaceInPattern = L'x',
@@ -672,17 +884,16 @@ protected:
       }
     }
     const string_type& pattern = string_adaptor::construct_from_utf16(wide_pattern.c_str());
-    return std::regex_search(string_adaptor::begin(str), string_adaptor::end(str),
-                                  std::basic_regex<typename string_adaptor::value_type>(
-                                      string_adaptor::begin(pattern), string_adaptor::end(pattern),
-                                      regex_syntax));
-  } // evaluate
+    return regex_ptr(new regex_type(string_adaptor::begin(pattern), string_adaptor::end(pattern), regex_syntax));
+  } // compile
 
-private:
   // Only used to construct error string.
-  std::string wideCharacterToStdString(wchar_t c) const {
+  static std::string wideCharacterToStdString(wchar_t c) {
     return default_string_adaptor<std::wstring>::asStdString(std::wstring(c, 1));
   }
+
+  regex_ptr regex_;
+  mutable CacheT cache_;
 }; // class MatchesFn
 
 ///////////////////////////////////////////////////////
@@ -784,12 +995,29 @@ protected:
   virtual double doEvaluate(const DOM::Node<string_type, string_adaptor>& context,
                      const ExecutionContext<string_type, string_adaptor>& executionContext) const
   {
-    double sum = 0;
-    NodeSet<string_type, string_adaptor> ns = baseT::argAsNodeSet(0, context, executionContext);
-    for(typename NodeSet<string_type, string_adaptor>::const_iterator n = ns.begin(), end = ns.end(); n != end; ++n)
-      sum += nodeNumberValue<string_type, string_adaptor>(*n);
-    return sum;
+    Adder adder;
+    baseT::argAsNodes(0, context, executionContext, adder);
+    return adder.sum();
   } // doEvaluate
+
+private:
+  // adds up in document order, so rounding comes out as it always has
+  class Adder : public impl::NodeVisitor<string_type, string_adaptor>
+  {
+  public:
+    Adder() : sum_(0) { }
+
+    virtual bool visit(const DOM::Node<string_type, string_adaptor>& node) 
+    { 
+      sum_ += nodeNumberValue<string_type, string_adaptor>(node); 
+      return true; 
+    } // visit
+
+    double sum() const { return sum_; }
+
+  private:
+    double sum_;
+  }; // class Adder
 }; // class SumFn
 
 // number floor(number)
@@ -1,6 +1,7 @@
 #ifndef ARABICA_XPATH_FUNCTION_HOLDER_HPP
 #define ARABICA_XPATH_FUNCTION_HOLDER_HPP
 
+#include <unordered_map>
 #include <boost/shared_ptr.hpp>
 #include "xpath_expression.hpp"
 #include "xpath_function.hpp"
@@ -12,9 +13,141 @@ namespace XPath
 namespace impl
 {
 
+// A compiled function call.  Core functions are held by value in a
+// BoundFunctionHolder, anything else found through a FunctionResolver 
+// sits behind a ResolvedFunctionHolder.
+template<class string_type, class string_adaptor>
+class FunctionHolder : public XPathExpression_impl<string_type, string_adaptor>
+{
+public:
+  const string_type& namespace_uri() const { return namespace_uri_; }
+  const string_type& name() const { return name_; }
+  const std::vector<XPathExpression<string_type, string_adaptor> >& args() const { return args_; }
+
+  static FunctionHolder* createFunction(const string_type& namespace_uri,
+                                        const string_type& name, 
+                                        const std::vector<XPathExpression<string_type, string_adaptor> >& argExprs,
+                                        const CompilationContext<string_type, string_adaptor>& context);
+
+protected:
+  FunctionHolder(const string_type& namespace_uri, 
+                 const string_type& name,
+                 const std::vector<XPathExpression<string_type, string_adaptor> >& args) :
+    namespace_uri_(namespace_uri),
+    name_(name),
+    args_(args)
+  {
+  } // FunctionHolder
+
+private:
+  string_type namespace_uri_;
+  string_type name_;
+  std::vector<XPathExpression<string_type, string_adaptor> > args_;
+}; // class FunctionHolder
+
+template<class string_type, class string_adaptor>
+class ResolvedFunctionHolder : public FunctionHolder<string_type, string_adaptor>
+{
+public:
+  ResolvedFunctionHolder(XPathFunction<string_type, string_adaptor>* func,
+                         const string_type& namespace_uri, 
+                         const string_type& name,
+                         const std::vector<XPathExpression<string_type, string_adaptor> >& argExprs) :
+    FunctionHolder<string_type, string_adaptor>(namespace_uri, name, argExprs),
+    func_(func)
+  {
+  } // ResolvedFunctionHolder
+
+  virtual ~ResolvedFunctionHolder()
+  {
+    delete func_;
+  } // ~ResolvedFunctionHolder
+
+  virtual ValueType type() const { return func_->type(); }
+
+  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
+                                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return XPathValue<string_type, string_adaptor>(func_->evaluate(context, executionContext));
+  } // evaluate
+
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context, 
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return func_->evaluateAsBool(context, executionContext);
+  } // evaluateAsBool
+
+  virtual double evaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context, 
+                                  const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return func_->evaluateAsNumber(context, executionContext);
+  } // evaluateAsNumber
+
+  virtual string_type evaluateAsString(const DOM::Node<string_type, string_adaptor>& context, 
+                                       const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return func_->evaluateAsString(context, executionContext);
+  } // evaluateAsString
+
+private:
+  XPathFunction<string_type, string_adaptor>* func_;
+}; // class ResolvedFunctionHolder
+
+// The function's exact type is known here, so the qualified calls below
+// are direct rather than through XPathFunction's vtable.
+template<class function_type, class string_type, class string_adaptor>
+class BoundFunctionHolder : public FunctionHolder<string_type, string_adaptor>
+{
+public:
+  BoundFunctionHolder(const std::vector<XPathExpression<string_type, string_adaptor> >& argExprs,
+                      const string_type& namespace_uri, 
+                      const string_type& name) :
+    FunctionHolder<string_type, string_adaptor>(namespace_uri, name, argExprs),
+    func_(argExprs)
+  {
+  } // BoundFunctionHolder
+
+  virtual ValueType type() const { return func_.function_type::type(); }
+
+  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
+                                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return XPathValue<string_type, string_adaptor>(func_.function_type::evaluate(context, executionContext));
+  } // evaluate
+
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context, 
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return func_.function_type::evaluateAsBool(context, executionContext);
+  } // evaluateAsBool
+
+  virtual double evaluateAsNumber(const DOM::Node<string_type, string_adaptor>& context, 
+                                  const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return func_.function_type::evaluateAsNumber(context, executionContext);
+  } // evaluateAsNumber
+
+  virtual string_type evaluateAsString(const DOM::Node<string_type, string_adaptor>& context, 
+                                       const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return func_.function_type::evaluateAsString(context, executionContext);
+  } // evaluateAsString
+
+private:
+  const function_type func_;
+}; // class BoundFunctionHolder
+
 template<class function_type, class string_type, class string_adaptor>
 XPathFunction<string_type, string_adaptor>* CreateFn(const std::vector<XPathExpression<string_type, string_adaptor> >& argExprs) { return new function_type(argExprs); }
 
+template<class function_type, class string_type, class string_adaptor>
+FunctionHolder<string_type, string_adaptor>* BindFn(const std::vector<XPathExpression<string_type, string_adaptor> >& argExprs,
+                                                    const string_type& namespace_uri, 
+                                                    const string_type& name) 
+{ 
+  return new BoundFunctionHolder<function_type, string_type, string_adaptor>(argExprs, namespace_uri, name); 
+} // BindFn
+
 } // namespace impl
 
   template<class string_type, class string_adaptor = Arabica::default_string_adaptor<string_type> >
@@ -49,128 +182,157 @@ public:
     return (fn != 0) ? fn->creator(argExprs) : 0;
   } // standardFunction
 
+  // the core function compiled straight into the expression tree, or 0 if 
+  // there's no such function
+  static impl::FunctionHolder<string_type, string_adaptor>*
+      bindFunction(const string_type& namespace_uri,
+                   const string_type& name,
+                   const std::vector<XPathExpression<string_type, string_adaptor> >& argExprs)
+  {
+    const NamedFunction* fn = findFunction(namespace_uri, name);
+    return (fn != 0) ? fn->binder(argExprs, namespace_uri, name) : 0;
+  } // bindFunction
+
+  // true if, called with argCount constant arguments, the function's result 
+  // depends only on those arguments and so can be worked out at compile time
+  static bool isFoldable(const string_type& namespace_uri,
+                         const string_type& name,
+                         size_t argCount)
+  {
+    const NamedFunction* fn = findFunction(namespace_uri, name);
+    return (fn != 0) && (fn->foldableArgs != -1) && (static_cast<int>(argCount) >= fn->foldableArgs);
+  } // isFoldable
+
 private:
   typedef XPathFunction<string_type, string_adaptor>* (*CreateFnPtr)(const std::vector<XPathExpression<string_type, string_adaptor> >& argExprs);
+  typedef impl::FunctionHolder<string_type, string_adaptor>* (*BindFnPtr)(const std::vector<XPathExpression<string_type, string_adaptor> >& argExprs,
+                                                                           const string_type& namespace_uri,
+                                                                           const string_type& name);
 
-  struct NamedFunction { const char* name; CreateFnPtr creator; };
+  // foldableArgs is the fewest arguments for which the result is context 
+  // independent - string() reads the context node, string('x') doesn't.
+  // -1 if the function can never be folded.
+  struct NamedFunction { const char* name; CreateFnPtr creator; BindFnPtr binder; int foldableArgs; };
 
   static const NamedFunction FunctionLookupTable[];
 
+  typedef std::unordered_map<string_type, const NamedFunction*, impl::hashStringValue<string_type, string_adaptor> > FunctionMap;
+
   static const NamedFunction* findFunction(const string_type& namespace_uri,
 					   const string_type& name) 
   {
     if(!string_adaptor::empty(namespace_uri))
       return 0;
 
-    for(const NamedFunction* fn = FunctionLookupTable; fn->name != 0; ++fn)
-      if(name == string_adaptor::construct_from_utf8(fn->name))
-	return fn;
-
-    return 0;
+    static const FunctionMap functions = buildFunctionMap();
+    typename FunctionMap::const_iterator fn = functions.find(name);
+    return (fn != functions.end()) ? fn->second : 0;
   } // findFunction
+
+  static FunctionMap buildFunctionMap()
+  {
+    FunctionMap functions;
+    for(const NamedFunction* fn = FunctionLookupTable; fn->name != 0; ++fn)
+      functions[string_adaptor::construct_from_utf8(fn->name)] = fn;
+    return functions;
+  } // buildFunctionMap
 }; // class StandardXPathFunctionResolver
 
 template<class string_type, class string_adaptor>
 const typename StandardXPathFunctionResolver<string_type, string_adaptor>::NamedFunction 
 StandardXPathFunctionResolver<string_type, string_adaptor>::FunctionLookupTable[] = 
       { // node-set functions
-        { "position",        impl::CreateFn<impl::PositionFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        { "last",            impl::CreateFn<impl::LastFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        { "count",           impl::CreateFn<impl::CountFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        { "local-name",      impl::CreateFn<impl::LocalNameFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        { "namespace-uri",   impl::CreateFn<impl::NamespaceURIFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        { "name",            impl::CreateFn<impl::NameFn<string_type, string_adaptor>, string_type, string_adaptor> },
+        { "position",        impl::CreateFn<impl::PositionFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::PositionFn<string_type, string_adaptor>, string_type, string_adaptor>, -1 },
+        { "last",            impl::CreateFn<impl::LastFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::LastFn<string_type, string_adaptor>, string_type, string_adaptor>, -1 },
+        { "count",           impl::CreateFn<impl::CountFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::CountFn<string_type, string_adaptor>, string_type, string_adaptor>, -1 },
+        { "local-name",      impl::CreateFn<impl::LocalNameFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::LocalNameFn<string_type, string_adaptor>, string_type, string_adaptor>, -1 },
+        { "namespace-uri",   impl::CreateFn<impl::NamespaceURIFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::NamespaceURIFn<string_type, string_adaptor>, string_type, string_adaptor>, -1 },
+        { "name",            impl::CreateFn<impl::NameFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::NameFn<string_type, string_adaptor>, string_type, string_adaptor>, -1 },
         // string functions
-        {"string",           impl::CreateFn<impl::StringFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"concat",           impl::CreateFn<impl::ConcatFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"starts-with",      impl::CreateFn<impl::StartsWithFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"contains",         impl::CreateFn<impl::ContainsFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"substring-before", impl::CreateFn<impl::SubstringBeforeFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"substring-after",  impl::CreateFn<impl::SubstringAfterFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"substring",        impl::CreateFn<impl::SubstringFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"string-length",    impl::CreateFn<impl::StringLengthFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"normalize-space",  impl::CreateFn<impl::NormalizeSpaceFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"translate",        impl::CreateFn<impl::TranslateFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"matches",          impl::CreateFn<impl::MatchesFn<string_type, string_adaptor>, string_type, string_adaptor> },
+        {"string",           impl::CreateFn<impl::StringFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::StringFn<string_type, string_adaptor>, string_type, string_adaptor>, 1 },
+        {"concat",           impl::CreateFn<impl::ConcatFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::ConcatFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"starts-with",      impl::CreateFn<impl::StartsWithFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::StartsWithFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"contains",         impl::CreateFn<impl::ContainsFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::ContainsFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"substring-before", impl::CreateFn<impl::SubstringBeforeFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::SubstringBeforeFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"substring-after",  impl::CreateFn<impl::SubstringAfterFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::SubstringAfterFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"substring",        impl::CreateFn<impl::SubstringFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::SubstringFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"string-length",    impl::CreateFn<impl::StringLengthFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::StringLengthFn<string_type, string_adaptor>, string_type, string_adaptor>, 1 },
+        {"normalize-space",  impl::CreateFn<impl::NormalizeSpaceFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::NormalizeSpaceFn<string_type, string_adaptor>, string_type, string_adaptor>, 1 },
+        {"translate",        impl::CreateFn<impl::TranslateFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::TranslateFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"matches",          impl::CreateFn<impl::MatchesFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::MatchesFn<string_type, string_adaptor>, string_type, string_adaptor>, -1 },
         // boolean functions
-        {"boolean",          impl::CreateFn<impl::BooleanFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"not",              impl::CreateFn<impl::NotFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"true",             impl::CreateFn<impl::TrueFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"false",            impl::CreateFn<impl::FalseFn<string_type, string_adaptor>, string_type, string_adaptor> },
+        {"boolean",          impl::CreateFn<impl::BooleanFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::BooleanFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"not",              impl::CreateFn<impl::NotFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::NotFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"true",             impl::CreateFn<impl::TrueFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::TrueFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"false",            impl::CreateFn<impl::FalseFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::FalseFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
         // number functions
-        {"number",           impl::CreateFn<impl::NumberFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"sum",              impl::CreateFn<impl::SumFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"floor",            impl::CreateFn<impl::FloorFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"ceiling",          impl::CreateFn<impl::CeilingFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {"round",            impl::CreateFn<impl::RoundFn<string_type, string_adaptor>, string_type, string_adaptor> },
-        {0,                  0}
+        {"number",           impl::CreateFn<impl::NumberFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::NumberFn<string_type, string_adaptor>, string_type, string_adaptor>, 1 },
+        {"sum",              impl::CreateFn<impl::SumFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::SumFn<string_type, string_adaptor>, string_type, string_adaptor>, -1 },
+        {"floor",            impl::CreateFn<impl::FloorFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::FloorFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"ceiling",          impl::CreateFn<impl::CeilingFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::CeilingFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {"round",            impl::CreateFn<impl::RoundFn<string_type, string_adaptor>, string_type, string_adaptor>,
+                             impl::BindFn<impl::RoundFn<string_type, string_adaptor>, string_type, string_adaptor>, 0 },
+        {0,                  0, 0, -1}
       };
 
 namespace impl 
 {
 
 template<class string_type, class string_adaptor>
-class FunctionHolder : public XPathExpression_impl<string_type, string_adaptor>
+FunctionHolder<string_type, string_adaptor>* 
+FunctionHolder<string_type, string_adaptor>::createFunction(const string_type& namespace_uri,
+                                                            const string_type& name, 
+                                                            const std::vector<XPathExpression<string_type, string_adaptor> >& argExprs,
+                                                            const CompilationContext<string_type, string_adaptor>& context)
 {
-public:
-  FunctionHolder(XPathFunction<string_type, string_adaptor>* func,
-                 const string_type& namespace_uri, 
-                 const string_type& name) :
-    func_(func),
-    namespace_uri_(namespace_uri),
-    name_(name)
+  if(string_adaptor::empty(namespace_uri))
   {
-  } // FunctionHolder
-
-  virtual ~FunctionHolder()
-  {
-    delete func_;
-  } // ~FunctionHolder
-
-  const string_type& namespace_uri() const { return namespace_uri_; }
-  const string_type& name() const { return name_; }
+    FunctionHolder* bound = StandardXPathFunctionResolver<string_type, string_adaptor>::bindFunction(namespace_uri, name, argExprs);
+    if(bound != 0)
+      return bound;
+  } // if ...
 
-  virtual ValueType type() const { return func_->type(); }
-
-  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
-                                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  XPathFunction<string_type, string_adaptor>* func = context.functionResolver().resolveFunction(namespace_uri, name, argExprs);
+  if(func == 0)
   {
-    return XPathValue<string_type, string_adaptor>(func_->evaluate(context, executionContext));
-  } // evaluate
-
-  static FunctionHolder* createFunction(const string_type& namespace_uri,
-                                        const string_type& name, 
-                                        const std::vector<XPathExpression<string_type, string_adaptor> >& argExprs,
-                                        const CompilationContext<string_type, string_adaptor>& context)
-  {
-    XPathFunction<string_type, string_adaptor>* func = 0;
-
-    if(string_adaptor::empty(namespace_uri))
-      func = StandardXPathFunctionResolver<string_type, string_adaptor>::standardFunction(namespace_uri, name, argExprs);
-    if(func == 0)
-      func = context.functionResolver().resolveFunction(namespace_uri, name, argExprs);
-
-    if(func == 0)
+    string_type error;
+    if(!string_adaptor::empty(namespace_uri))
     {
-      string_type error;
-      if(!string_adaptor::empty(namespace_uri))
-      {
-        string_adaptor::append(error, string_adaptor::construct_from_utf8("{"));
-        string_adaptor::append(error, namespace_uri);
-        string_adaptor::append(error, string_adaptor::construct_from_utf8("}"));
-      } // if ...
-      string_adaptor::append(error, name);
-      throw UndefinedFunctionException(string_adaptor().asStdString(error));
-    } // if(func == 0)
+      string_adaptor::append(error, string_adaptor::construct_from_utf8("{"));
+      string_adaptor::append(error, namespace_uri);
+      string_adaptor::append(error, string_adaptor::construct_from_utf8("}"));
+    } // if ...
+    string_adaptor::append(error, name);
+    throw UndefinedFunctionException(string_adaptor().asStdString(error));
+  } // if(func == 0)
     
-    return new FunctionHolder(func, namespace_uri, name);
-  } // createFunction
-
-private:
-  XPathFunction<string_type, string_adaptor>* func_;
-  string_type namespace_uri_;
-  string_type name_;
-}; // class FunctionHolder
+  return new ResolvedFunctionHolder<string_type, string_adaptor>(func, namespace_uri, name, argExprs);
+} // createFunction
 
 } // namespace impl
 } // namespace XPath
@@ -48,8 +48,8 @@ public:
     // to a boolean as if by a call to the boolean function. The result is true if either 
     // value is true and false otherwise. The right operand is not evaluated if the 
     // left operand evaluates to true.
-    return lhs()->evaluate(context, executionContext).asBool() || 
-           rhs()->evaluate(context, executionContext).asBool();
+    return lhs()->evaluateAsBool(context, executionContext) || 
+           rhs()->evaluateAsBool(context, executionContext);
   } // evaluateAsBool
 }; // class OrOperator
 
@@ -72,8 +72,8 @@ public:
     // to a boolean as if by a call to the boolean function. The result is true if both 
     // values are true and false otherwise. The right operand is not evaluated if the left 
     // operand evaluates to false.
-    return lhs()->evaluate(context, executionContext).asBool() &&
-           rhs()->evaluate(context, executionContext).asBool();
+    return lhs()->evaluateAsBool(context, executionContext) &&
+           rhs()->evaluateAsBool(context, executionContext);
   } // evaluateAsBool
 }; // class AndOperator
 
@@ -2,7 +2,9 @@
 #define ARABICA_XPATHIC_MATCH_HPP
 
 #include <vector>
+#include <map>
 #include "xpath_expression.hpp"
+#include "xpath_node_test.hpp"
 #include "xpath_value.hpp"
 
 namespace Arabica
@@ -16,11 +18,28 @@ class MatchExpr
 public:
   MatchExpr(XPathExpression_impl<string_type, string_adaptor>* match, double priority);
   MatchExpr(const MatchExpr& rhs) :
-    match_(rhs.match_), priority_(rhs.priority_) { } 
+    match_(rhs.match_), priority_(rhs.priority_),
+    node_type_(rhs.node_type_), has_name_(rhs.has_name_), name_uri_(rhs.name_uri_), name_(rhs.name_) { } 
   MatchExpr& operator=(const MatchExpr& rhs)
-  { match_ = rhs.match_; priority_ = rhs.priority_; return *this; }
+  { 
+    match_ = rhs.match_; priority_ = rhs.priority_; 
+    node_type_ = rhs.node_type_; has_name_ = rhs.has_name_; name_uri_ = rhs.name_uri_; name_ = rhs.name_;
+    return *this; 
+  } // operator=
 
   double priority() const { return priority_; }
+
+  // Any node the pattern matches has this node type, or 0 if it could be
+  // any type at all.  TEXT_NODE covers CDATA sections and DOCUMENT_NODE 
+  // document fragments, while an ELEMENT_NODE pattern can match namespace
+  // nodes too.
+  int node_type() const { return node_type_; }
+  // If has_name(), any node the pattern matches also has this name - its
+  // node name when name_uri() is empty, otherwise its local name in that
+  // namespace.
+  bool has_name() const { return has_name_; }
+  const string_type& name_uri() const { return name_uri_; }
+  const string_type& name() const { return name_; }
   bool evaluate(const DOM::Node<string_type, string_adaptor>& context,
                 const ExecutionContext<string_type, string_adaptor>& executionContext) const
   {
@@ -30,13 +49,122 @@ public:
   void override_priority(double p) { priority_ = p; }
 
 private:
+  void narrow(const impl::NodeTest<string_type, string_adaptor>* test);
+
   XPathExpression<string_type, string_adaptor> match_;
   double priority_;
+  int node_type_;
+  bool has_name_;
+  string_type name_uri_;
+  string_type name_;
 
   MatchExpr();
   bool operator==(const MatchExpr&) const;
 }; // MatchExpr
 
+// Files items by the type and name of node their match patterns can match,
+// so a node need only be tried against the patterns in its own list.  Every
+// list keeps the order the items were added in.
+template<class Item, class string_type, class string_adaptor = Arabica::default_string_adaptor<string_type> >
+class MatchIndex
+{
+public:
+  typedef std::vector<Item> Candidates;
+
+  void add(const MatchExpr<string_type, string_adaptor>& match, const Item& item)
+  {
+    const int type = match.node_type();
+
+    all_.push_back(item);
+    if(type == 0)
+    {
+      any_type_.push_back(item);
+      for(typename ByType::iterator b = by_type_.begin(), be = by_type_.end(); b != be; ++b)
+        b->second.push_back(item);
+      addToAll(elements_, item);
+      addToAll(attributes_, item);
+      return;
+    } // if ...
+
+    typename ByType::iterator of_type = by_type_.find(type);
+    if(of_type == by_type_.end())
+      of_type = by_type_.insert(std::make_pair(type, any_type_)).first;
+
+    if(!match.has_name())
+    {
+      of_type->second.push_back(item);
+      if(type == DOM::Node_base::ELEMENT_NODE)
+        addToAll(elements_, item);
+      if(type == DOM::Node_base::ATTRIBUTE_NODE)
+        addToAll(attributes_, item);
+      return;
+    } // if ...
+
+    ByName& names = (type == DOM::Node_base::ELEMENT_NODE) ? elements_ : attributes_;
+    Name name(match.name_uri(), match.name());
+    typename ByName::iterator entry = names.find(name);
+    if(entry == names.end())
+      entry = names.insert(std::make_pair(name, of_type->second)).first;
+    entry->second.push_back(item);
+  } // add
+
+  const Candidates& candidates(const DOM::Node<string_type, string_adaptor>& node) const
+  {
+    int type = node.getNodeType();
+    switch(type)
+    {
+      case DOM::Node_base::ELEMENT_NODE:
+        return named(elements_, node);
+      case DOM::Node_base::ATTRIBUTE_NODE:
+        return named(attributes_, node);
+      case DOM::Node_base::CDATA_SECTION_NODE:
+        return ofType(DOM::Node_base::TEXT_NODE);
+      case DOM::Node_base::DOCUMENT_FRAGMENT_NODE:
+        return ofType(DOM::Node_base::DOCUMENT_NODE);
+      case DOM::Node_base::TEXT_NODE:
+      case DOM::Node_base::COMMENT_NODE:
+      case DOM::Node_base::PROCESSING_INSTRUCTION_NODE:
+      case DOM::Node_base::DOCUMENT_NODE:
+        return ofType(type);
+    } // switch 
+    return all_;
+  } // candidates
+
+  bool empty() const { return all_.empty(); }
+
+private:
+  typedef std::map<int, Candidates> ByType;
+  typedef std::pair<string_type, string_type> Name;
+  typedef std::map<Name, Candidates> ByName;
+
+  static void addToAll(ByName& names, const Item& item)
+  {
+    for(typename ByName::iterator n = names.begin(), ne = names.end(); n != ne; ++n)
+      n->second.push_back(item);
+  } // addToAll
+
+  const Candidates& ofType(int type) const
+  {
+    typename ByType::const_iterator b = by_type_.find(type);
+    return (b != by_type_.end()) ? b->second : any_type_;
+  } // ofType
+
+  const Candidates& named(const ByName& names, const DOM::Node<string_type, string_adaptor>& node) const
+  {
+    const string_type& uri = node.getNamespaceURI();
+    typename ByName::const_iterator n = string_adaptor::empty(uri) ? 
+                                          names.find(Name(uri, node.getNodeName())) :
+                                          names.find(Name(uri, node.getLocalName()));
+    return (n != names.end()) ? n->second : ofType(node.getNodeType());
+  } // named
+
+  Candidates all_;
+  Candidates any_type_;
+  ByType by_type_;
+  ByName elements_;
+  ByName attributes_;
+}; // class MatchIndex
+
 namespace impl
 {
 
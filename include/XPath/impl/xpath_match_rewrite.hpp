@@ -88,7 +88,7 @@ namespace impl
 
 template<class string_type, class string_adaptor>
 MatchExpr<string_type, string_adaptor>::MatchExpr(XPathExpression_impl<string_type, string_adaptor>* match, double priority) :
-  match_(match), priority_(priority) 
+  match_(match), priority_(priority), node_type_(0), has_name_(false) 
 {
   typedef impl::RelativeLocationPath<string_type, string_adaptor> RelativeLocation;
   typedef impl::StepList<string_type, string_adaptor> StepList;
@@ -118,9 +118,69 @@ MatchExpr<string_type, string_adaptor>::MatchExpr(XPathExpression_impl<string_ty
       predicates.erase(predicates.begin(), positional);
       positional = std::find_if(predicates.begin(), predicates.end(), impl::should_rewrite<string_type, string_adaptor>);
     } // while ...
+    step->analysePredicates();
   } // for(StepList::const_iterator ...
+
+  // the leading self:: steps all test the matched node itself
+  if(dynamic_cast<impl::AbsoluteLocationPath<string_type, string_adaptor>*>(path) != 0)
+    return;
+  for(typename StepList::const_iterator s = steps.begin(), se = steps.end(); s != se; ++s)
+  {
+    Step* step = dynamic_cast<Step*>(*s);
+    if(!step || step->axis() != SELF)
+      break;
+    narrow(step->test());
+  } // for ...
 } // MatchExpr
 
+template<class string_type, class string_adaptor>
+void MatchExpr<string_type, string_adaptor>::narrow(const impl::NodeTest<string_type, string_adaptor>* test)
+{
+  typedef string_adaptor SA;
+  if(has_name_)
+    return;
+
+  if(const impl::NameNodeTest<string_type, string_adaptor>* t = dynamic_cast<const impl::NameNodeTest<string_type, string_adaptor>*>(test))
+  {
+    node_type_ = DOM::Node_base::ELEMENT_NODE;
+    has_name_ = true;
+    name_ = t->name();
+  }
+  else if(const impl::QNameNodeTest<string_type, string_adaptor>* t = dynamic_cast<const impl::QNameNodeTest<string_type, string_adaptor>*>(test))
+  {
+    node_type_ = DOM::Node_base::ELEMENT_NODE;
+    // an element in no namespace is known by its node name, not its local name
+    has_name_ = !SA::empty(t->namespace_uri());
+    name_uri_ = t->namespace_uri();
+    name_ = t->name();
+  }
+  else if(const impl::AttributeNameNodeTest<string_type, string_adaptor>* t = dynamic_cast<const impl::AttributeNameNodeTest<string_type, string_adaptor>*>(test))
+  {
+    node_type_ = DOM::Node_base::ATTRIBUTE_NODE;
+    has_name_ = true;
+    name_ = t->name();
+  }
+  else if(const impl::AttributeQNameNodeTest<string_type, string_adaptor>* t = dynamic_cast<const impl::AttributeQNameNodeTest<string_type, string_adaptor>*>(test))
+  {
+    node_type_ = DOM::Node_base::ATTRIBUTE_NODE;
+    has_name_ = !SA::empty(t->namespace_uri());
+    name_uri_ = t->namespace_uri();
+    name_ = t->name();
+  }
+  else if(dynamic_cast<const impl::StarNodeTest<string_type, string_adaptor>*>(test))
+    node_type_ = DOM::Node_base::ELEMENT_NODE;
+  else if(dynamic_cast<const impl::AttributeNodeTest<string_type, string_adaptor>*>(test))
+    node_type_ = DOM::Node_base::ATTRIBUTE_NODE;
+  else if(dynamic_cast<const impl::TextNodeTest<string_type, string_adaptor>*>(test))
+    node_type_ = DOM::Node_base::TEXT_NODE;
+  else if(dynamic_cast<const impl::CommentNodeTest<string_type, string_adaptor>*>(test))
+    node_type_ = DOM::Node_base::COMMENT_NODE;
+  else if(dynamic_cast<const impl::ProcessingInstructionNodeTest<string_type, string_adaptor>*>(test))
+    node_type_ = DOM::Node_base::PROCESSING_INSTRUCTION_NODE;
+  else if(dynamic_cast<const impl::RootNodeTest<string_type, string_adaptor>*>(test))
+    node_type_ = DOM::Node_base::DOCUMENT_NODE;
+} // narrow
+
 } // namespace XPath
 
 } // namespace Arabica
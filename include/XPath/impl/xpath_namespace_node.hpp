@@ -8,6 +8,7 @@
 #include <DOM/Simple/DocumentImpl.hpp>
 #include <DOM/Simple/NodeImpl.hpp>
 #include <Arabica/StringAdaptor.hpp>
+#include <vector>
 
 namespace Arabica
 {
@@ -28,14 +29,16 @@ class NamespaceNodeImpl : public DOM::Node_impl<stringT, string_adaptorT>
     typedef DOM::NodeList_impl<stringT, string_adaptorT> NodeListT;
     typedef DOM::NamedNodeMap_impl<stringT, string_adaptorT> NamedNodeMapT;
     typedef DOM::Document_impl<stringT, string_adaptorT> DocumentImplT;
+    typedef typename SimpleDOM::DocumentImpl<stringT, string_adaptorT>::NamespaceListT NamespaceListT;
+    typedef typename SimpleDOM::DocumentImpl<stringT, string_adaptorT>::NamespaceListPtrT NamespaceListPtrT;
 
     NamespaceNodeImpl(const NodeT& parentNode,
                       const stringT& localname,
                       const stringT& value) : 
         NodeImplT(),
         parentNode_(parentNode.underlying_impl()),
-        localname_(localname),
-        value_(value),
+        namespaces_(new NamespaceListT(1, std::make_pair(localname, value))),
+        index_(0),
         ref_(0)
     { 
     } // NamespaceNodeImpl
@@ -45,14 +48,45 @@ class NamespaceNodeImpl : public DOM::Node_impl<stringT, string_adaptorT>
                       const stringT& value) : 
         NodeImplT(),
         parentNode_(parentNode),
-        localname_(localname),
-        value_(value),
+        namespaces_(new NamespaceListT(1, std::make_pair(localname, value))),
+        index_(0),
+        ref_(0)
+    { 
+    } // NamespaceNodeImpl
+
+    // a flyweight over an entry in a shared list of in-scope namespaces
+    NamespaceNodeImpl(NodeImplT* parentNode,
+                      const NamespaceListPtrT& namespaces,
+                      size_t index) : 
+        NodeImplT(),
+        parentNode_(parentNode),
+        namespaces_(namespaces),
+        index_(index),
         ref_(0)
     { 
     } // NamespaceNodeImpl
 
     virtual ~NamespaceNodeImpl() { }
 
+    // Walking the namespace axis makes and drops a node at every step, so 
+    // each thread keeps a few dropped nodes to hand out again rather than
+    // going back to the allocator every time.
+    static NamespaceNodeImpl* create(NodeImplT* parentNode,
+                                     const NamespaceListPtrT& namespaces,
+                                     size_t index)
+    {
+      std::vector<NamespaceNodeImpl*>& spares = pool().spares;
+      if(spares.empty())
+        return new NamespaceNodeImpl(parentNode, namespaces, index);
+
+      NamespaceNodeImpl* node = spares.back();
+      spares.pop_back();
+      node->parentNode_ = parentNode;
+      node->namespaces_ = namespaces;
+      node->index_ = index;
+      return node;
+    } // create
+
     ////////////////////////////////////////////////////////
     // not fully part of the document, so need to manage our own lifetime
     virtual void addRef()
@@ -65,14 +99,14 @@ class NamespaceNodeImpl : public DOM::Node_impl<stringT, string_adaptorT>
     {
       parentNode_->releaseRef();
       if(!(--ref_))
-        delete this;
+        recycle();
     } // releaseRef
 
     ///////////////////////////////////////////////////////
     // DOM::Node methods
-    virtual const stringT& getNodeName() const { return localname_; }
+    virtual const stringT& getNodeName() const { return (*namespaces_)[index_].first; }
 
-    virtual const stringT& getNodeValue() const { return value_; }
+    virtual const stringT& getNodeValue() const { return (*namespaces_)[index_].second; }
     virtual void setNodeValue(const stringT&) { oopsReadOnly(); }
     
     virtual DOM::Node_base::Type getNodeType() const { return NAMESPACE_NODE_TYPE; }
@@ -99,7 +133,7 @@ class NamespaceNodeImpl : public DOM::Node_impl<stringT, string_adaptorT>
 
     virtual bool hasChildNodes() const { return false; }
 
-    virtual NodeImplT* cloneNode(bool /* deep */) const { return new NamespaceNodeImpl<stringT, string_adaptorT>(parentNode_, localname_, value_); } 
+    virtual NodeImplT* cloneNode(bool /* deep */) const { return new NamespaceNodeImpl<stringT, string_adaptorT>(parentNode_, namespaces_, index_); } 
 
     virtual void normalize() { }
 
@@ -108,7 +142,7 @@ class NamespaceNodeImpl : public DOM::Node_impl<stringT, string_adaptorT>
     virtual const stringT& getNamespaceURI() const { return empty_; }
     virtual const stringT& getPrefix() const { return empty_; }
     virtual void setPrefix(const stringT&) { oopsReadOnly(); }
-    virtual const stringT& getLocalName() const { return localname_; }
+    virtual const stringT& getLocalName() const { return (*namespaces_)[index_].first; }
 
     virtual bool hasNamespaceURI() const { return false; }
     virtual bool hasPrefix() const { return false; }
@@ -118,9 +152,40 @@ class NamespaceNodeImpl : public DOM::Node_impl<stringT, string_adaptorT>
   private:
     void oopsReadOnly() const { throw DOM::DOMException(DOM::DOMException::NO_MODIFICATION_ALLOWED_ERR); }
 
+    struct Pool
+    {
+      ~Pool()
+      {
+        for(typename std::vector<NamespaceNodeImpl*>::iterator s = spares.begin(), se = spares.end(); s != se; ++s)
+          delete *s;
+      } // ~Pool
+
+      std::vector<NamespaceNodeImpl*> spares;
+    }; // struct Pool
+    enum { MaxSpares = 16 };
+
+    static Pool& pool()
+    {
+      static thread_local Pool p;
+      return p;
+    } // pool
+
+    void recycle()
+    {
+      std::vector<NamespaceNodeImpl*>& spares = pool().spares;
+      if(spares.size() == MaxSpares)
+      {
+        delete this;
+        return;
+      } // if ...
+      namespaces_.reset();
+      parentNode_ = 0;
+      spares.push_back(this);
+    } // recycle
+
     NodeImplT* parentNode_;
-    stringT localname_;
-    stringT value_;
+    NamespaceListPtrT namespaces_;
+    size_t index_;
     const stringT empty_;
     unsigned int ref_;
 }; // class NamespaceNodeImpl
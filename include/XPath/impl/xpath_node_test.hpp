@@ -61,6 +61,8 @@ public:
   NameNodeTest(const string_type& name) : name_(name) { }
   virtual NodeTest<string_type, string_adaptor>* clone() const { return new NameNodeTest(name_); }
 
+  const string_type& name() const { return name_; }
+
   virtual bool operator()(const DOM::Node<string_type, string_adaptor>& node) const
   {
     int type = node.getNodeType();
@@ -80,6 +82,8 @@ public:
   AttributeNameNodeTest(const string_type& name) : name_(name) { }
   virtual NodeTest<string_type, string_adaptor>* clone() const { return new AttributeNameNodeTest(name_); }
 
+  const string_type& name() const { return name_; }
+
   virtual bool operator()(const DOM::Node<string_type, string_adaptor>& node) const
   {
     return node.getNodeType() == DOM::Node_base::ATTRIBUTE_NODE &&
@@ -99,6 +103,9 @@ public:
       uri_(namespace_uri), name_(name) { }
   virtual NodeTest<string_type, string_adaptor>* clone() const { return new QNameNodeTest(uri_, name_); }
 
+  const string_type& namespace_uri() const { return uri_; }
+  const string_type& name() const { return name_; }
+
   virtual bool operator()(const DOM::Node<string_type, string_adaptor>& node) const
   {
     int type = node.getNodeType();
@@ -120,6 +127,9 @@ public:
       uri_(namespace_uri), name_(name) { }
   virtual NodeTest<string_type, string_adaptor>* clone() const { return new AttributeQNameNodeTest(uri_, name_); }
 
+  const string_type& namespace_uri() const { return uri_; }
+  const string_type& name() const { return name_; }
+
   virtual bool operator()(const DOM::Node<string_type, string_adaptor>& node) const
   {
     return node.getNodeType() == DOM::Node_base::ATTRIBUTE_NODE &&
@@ -4,6 +4,9 @@
 #include <string>
 #include <vector>
 #include <utility>
+#include <unordered_set>
+#include <functional>
+#include <algorithm>
 #include <DOM/Node.hpp>
 #include <DOM/Attr.hpp>
 #include <boost/shared_ptr.hpp>
@@ -12,8 +15,19 @@
 #include <math>
 #endif
 #include <cmath>
+#include <sstream>
+#include <locale>
+#if (__cplusplus >= 201703L) && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+#if defined(__cpp_lib_to_chars) && !defined(ARABICA_HAS_FROM_CHARS)
+#define ARABICA_HAS_FROM_CHARS
+#endif
 #include <Arabica/StringAdaptor.hpp>
 #include <text/normalize_whitespace.hpp>
+#include <text/UnicodeCharacters.hpp>
 #include "xpath_axis_enumerator.hpp"
 
 namespace Arabica
@@ -184,6 +198,7 @@ class NodeSet
 public:
   typedef typename std::vector<DOM::Node<string_type, string_adaptor> >::const_iterator const_iterator;
   typedef typename std::vector<DOM::Node<string_type, string_adaptor> >::iterator iterator;
+  typedef typename std::vector<DOM::Node<string_type, string_adaptor> >::const_reverse_iterator const_reverse_iterator;
   typedef typename std::vector<DOM::Node<string_type, string_adaptor> >::value_type value_type;
 
   NodeSet() : 
@@ -226,6 +241,8 @@ public:
   const_iterator end() const { return nodes_.end(); }
   iterator begin() { return nodes_.begin(); }
   iterator end() { return nodes_.end(); }
+  const_reverse_iterator rbegin() const { return nodes_.rbegin(); }
+  const_reverse_iterator rend() const { return nodes_.rend(); }
   const DOM::Node<string_type, string_adaptor>& operator[](size_t i) const { return nodes_[i]; }
   size_t size() const { return nodes_.size(); }
   bool empty() const { return nodes_.empty(); }
@@ -259,6 +276,16 @@ public:
     sorted_ = false;
   } // forward
 
+  // for callers who've built the set from a source already in document 
+  // order, without duplicates, so it never needs to be sorted
+  void in_document_order()
+  {
+    forward_ = true;
+    sorted_ = true;
+  } // in_document_order
+
+  void reserve(size_t n) { nodes_.reserve(n); }
+
   void to_document_order() 
   {
     sort();
@@ -416,22 +443,123 @@ inline double roundNumber(double value)
   return value;
 } // roundNumber
 
+template<class char_type>
+bool isNumberSpace(char_type c)
+{
+  typedef Arabica::text::Unicode<char_type> UnicodeT;
+  return (c == UnicodeT::SPACE) || (c == UnicodeT::HORIZONTAL_TABULATION) ||
+         (c == UnicodeT::CARRIAGE_RETURN) || (c == UnicodeT::LINE_FEED);
+} // isNumberSpace
+
+template<class char_type>
+bool isNumberDigit(char_type c)
+{
+  typedef Arabica::text::Unicode<char_type> UnicodeT;
+  return (c >= UnicodeT::NUMBER_0) && (c <= UnicodeT::NUMBER_9);
+} // isNumberDigit
+
+// correctly rounded conversion for the numbers too long for the fast path in
+// stringAsNumber - text is already known to be [-]digits[.digits]
+inline double parseNumber(const char* text, size_t length)
+{
+#ifdef ARABICA_HAS_FROM_CHARS
+  double value = NaN;
+  std::from_chars(text, text + length, value);
+  return value;
+#else
+  std::istringstream is(std::string(text, length));
+  is.imbue(std::locale::classic());
+  double value = NaN;
+  is >> value;
+  return value;
+#endif
+} // parseNumber
+
+// XPath's string to number conversion - 
+//   Number ::= '-'? (Digits ('.' Digits?)? | '.' Digits)
+// with optional whitespace either side.  Anything else, including '+1.5', 
+// exponents, 'inf' and so on, is NaN.
 template<class string_type, class string_adaptor>
 double stringAsNumber(const string_type& str)
 {
-  try {
-    static string_type PLUS = string_adaptor::construct_from_utf8("+");
-
-    string_type n_str = Arabica::text::normalize_whitespace<string_type, string_adaptor>(str);
-    // '+1.5' is not a number according to XPath spec, counter intuitive as that is
-    if(string_adaptor::find(n_str, PLUS) == 0)
-      return NaN;
-    
-    return boost::lexical_cast<double>(n_str);
-  } // try
-  catch(const boost::bad_lexical_cast&) {
+  typedef typename string_adaptor::value_type char_type;
+  typedef Arabica::text::Unicode<char_type> UnicodeT;
+  typedef typename string_adaptor::const_iterator const_iterator;
+
+  const_iterator i = string_adaptor::begin(str), ie = string_adaptor::end(str);
+  while((i != ie) && isNumberSpace(*i))
+    ++i;
+
+  const const_iterator start = i;
+  bool negative = false;
+  if((i != ie) && (*i == UnicodeT::HYPHEN_MINUS))
+  {
+    negative = true;
+    ++i;
+  } // if ...
+
+  // gather up to 15 significant digits, which a double holds exactly
+  const int MaxSignificant = 15;
+  unsigned long long mantissa = 0;
+  int significant = 0;
+  int exponent = 0;
+  int digits = 0;
+  bool seenPoint = false;
+  for(; i != ie; ++i)
+  {
+    char_type c = *i;
+    if(c == UnicodeT::FULL_STOP)
+    {
+      if(seenPoint)
+        return NaN;
+      seenPoint = true;
+      continue;
+    } // if ...
+    if(!isNumberDigit(c))
+      break;
+
+    ++digits;
+    if((mantissa == 0) && (c == UnicodeT::NUMBER_0))
+    {
+      if(seenPoint)
+        --exponent;
+      continue;
+    } // if ...
+
+    if(significant < MaxSignificant)
+    {
+      mantissa = mantissa * 10 + (c - UnicodeT::NUMBER_0);
+      if(seenPoint)
+        --exponent;
+    }
+    else if(!seenPoint)
+      ++exponent;
+    ++significant;
+  } // for ...
+  const const_iterator end = i;
+
+  while((i != ie) && isNumberSpace(*i))
+    ++i;
+  if((i != ie) || (digits == 0))
     return NaN;
-  } // catch
+
+  static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 
+                                       1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+  if((significant <= MaxSignificant) && (exponent >= -22) && (exponent <= 22))
+  {
+    // mantissa and power of ten are both exact, so one multiply or 
+    // divide gives a correctly rounded result
+    double value = static_cast<double>(mantissa);
+    value = (exponent < 0) ? value / powersOf10[-exponent] : value * powersOf10[exponent];
+    return negative ? -value : value;
+  } // if ...
+
+  // long hand - everything in there is ASCII, so narrowing is safe
+  std::string narrow;
+  narrow.reserve(end - start);
+  for(const_iterator c = start; c != end; ++c)
+    narrow += static_cast<char>(*c);
+  return parseNumber(narrow.data(), narrow.length());
 } // stringAsNumber
 
 template<class string_type, class string_adaptor>
@@ -441,6 +569,37 @@ bool nodeIsText(const DOM::Node<string_type, string_adaptor>& node)
          (node.getNodeType() == DOM::Node_base::CDATA_SECTION_NODE);
 } // nodeIsText
 
+template<class string_type, class string_adaptor>
+bool nodeIsText(const DOM::Node_impl<string_type, string_adaptor>* node)
+{
+  return (node->getNodeType() == DOM::Node_base::TEXT_NODE) ||
+         (node->getNodeType() == DOM::Node_base::CDATA_SECTION_NODE);
+} // nodeIsText
+
+// string-value of an element or document is its text descendants, end to end
+// - size it up first, so the result only gets allocated once
+template<class string_type, class string_adaptor>
+size_t descendantTextLength(const DOM::Node_impl<string_type, string_adaptor>* node)
+{
+  size_t length = 0;
+  for(const DOM::Node_impl<string_type, string_adaptor>* child = node->getFirstChild(); child != 0; child = child->getNextSibling())
+    if(nodeIsText<string_type, string_adaptor>(child))
+      length += string_adaptor::length(child->getNodeValue());
+    else
+      length += descendantTextLength<string_type, string_adaptor>(child);
+  return length;
+} // descendantTextLength
+
+template<class string_type, class string_adaptor>
+void appendDescendantText(const DOM::Node_impl<string_type, string_adaptor>* node, string_type& value)
+{
+  for(const DOM::Node_impl<string_type, string_adaptor>* child = node->getFirstChild(); child != 0; child = child->getNextSibling())
+    if(nodeIsText<string_type, string_adaptor>(child))
+      string_adaptor::append(value, child->getNodeValue());
+    else
+      appendDescendantText<string_type, string_adaptor>(child, value);
+} // appendDescendantText
+
 template<class string_type, class string_adaptor>
 string_type nodeStringValue(const DOM::Node<string_type, string_adaptor>& node)
 {
@@ -450,15 +609,18 @@ string_type nodeStringValue(const DOM::Node<string_type, string_adaptor>& node)
   case DOM::Node_base::DOCUMENT_FRAGMENT_NODE:
   case DOM::Node_base::ELEMENT_NODE:
     {
-      std::basic_ostringstream<typename string_adaptor::value_type> os;
-      AxisEnumerator<string_type, string_adaptor> ae(node, DESCENDANT);
-      while(*ae != 0)
-      {
-        if(nodeIsText<string_type, string_adaptor>(*ae))
-          os << nodeStringValue(*ae);
-        ++ae;
-      } // while
-      return string_adaptor::construct(os.str().c_str());
+      const DOM::Node_impl<string_type, string_adaptor>* impl = node.underlying_impl();
+      const DOM::Node_impl<string_type, string_adaptor>* first = impl->getFirstChild();
+      if(first == 0)
+        return string_adaptor::empty_string();
+      // the common case - <item>text</item>
+      if((first->getNextSibling() == 0) && nodeIsText<string_type, string_adaptor>(first))
+        return first->getNodeValue();
+
+      string_type value;
+      string_adaptor::reserve(value, descendantTextLength<string_type, string_adaptor>(impl));
+      appendDescendantText<string_type, string_adaptor>(impl, value);
+      return value;
     } // case
 
   case DOM::Node_base::ATTRIBUTE_NODE:
@@ -470,15 +632,22 @@ string_type nodeStringValue(const DOM::Node<string_type, string_adaptor>& node)
   case DOM::Node_base::TEXT_NODE:
   case DOM::Node_base::CDATA_SECTION_NODE:
     {
-      DOM::Node<string_type, string_adaptor> next = node.getNextSibling();
-      if((next == 0) ||
-	 !nodeIsText<string_type, string_adaptor>(next))
-	return node.getNodeValue();
-
-      std::basic_ostringstream<typename string_adaptor::value_type> os;
-      os << node.getNodeValue() 
-	 << nodeStringValue<string_type, string_adaptor>(next);
-      return string_adaptor::construct(os.str().c_str());
+      // a text node runs on through any adjacent text siblings
+      typedef const DOM::Node_impl<string_type, string_adaptor>* RawNodeT;
+      RawNodeT text = node.underlying_impl();
+      RawNodeT next = text->getNextSibling();
+      if((next == 0) || !nodeIsText<string_type, string_adaptor>(next))
+        return text->getNodeValue();
+
+      size_t length = 0;
+      for(RawNodeT t = text; (t != 0) && nodeIsText<string_type, string_adaptor>(t); t = t->getNextSibling())
+        length += string_adaptor::length(t->getNodeValue());
+
+      string_type value;
+      string_adaptor::reserve(value, length);
+      for(RawNodeT t = text; (t != 0) && nodeIsText<string_type, string_adaptor>(t); t = t->getNextSibling())
+        string_adaptor::append(value, t->getNodeValue());
+      return value;
     } // case
 
   default:
@@ -528,52 +697,64 @@ private:
   compareNodeWith& operator=(const compareNodeWith&);
 }; // class compareNodeWith
 
-template<class string_type, class string_adaptor, class predicate1, class predicate2>
-bool nodeSetsCompare(const XPathValue<string_type, string_adaptor>& lhs, const XPathValue<string_type, string_adaptor>& rhs)
+template<class string_type, class string_adaptor>
+struct hashStringValue
 {
-  const NodeSet<string_type, string_adaptor>& lns = lhs.asNodeSet();
-  const NodeSet<string_type, string_adaptor>& rns = rhs.asNodeSet();
+  size_t operator()(const string_type& value) const
+  {
+    size_t h = 2166136261u;
+    for(typename string_adaptor::const_iterator i = string_adaptor::begin(value), ie = string_adaptor::end(value); i != ie; ++i)
+      h = (h ^ static_cast<size_t>(*i)) * 16777619u;
+    return h;
+  } // operator()
+}; // struct hashStringValue
+
+template<class string_type, class string_adaptor>
+bool nodeSetsEqual(const XPathValue<string_type, string_adaptor>& lhs, const XPathValue<string_type, string_adaptor>& rhs)
+{
+  typedef NodeSet<string_type, string_adaptor> NodeSetT;
+  const NodeSetT& lns = lhs.asNodeSet();
+  const NodeSetT& rns = rhs.asNodeSet();
 
   if((lns.size() == 0) || (rns.size() == 0))
     return false;
 
-  std::set<string_type> values;
-  typename NodeSet<string_type, string_adaptor>::const_iterator l = lns.begin();
-  string_type lvalue = nodeStringValue<string_type, string_adaptor>(*l);
+  // take each string-value of the smaller set once, then probe with the larger
+  const NodeSetT& smaller = (lns.size() <= rns.size()) ? lns : rns;
+  const NodeSetT& larger = (lns.size() <= rns.size()) ? rns : lns;
 
-  predicate1 p1;
-  for(typename NodeSet<string_type, string_adaptor>::const_iterator r = rns.begin(), rend = rns.end(); r != rend; ++r)
-  {
-    string_type rvalue = nodeStringValue<string_type, string_adaptor>(*r);
-    if(p1(lvalue, rvalue))
-      return true;
-    values.insert(rvalue);
-  } // for ...
+  if(smaller.size() == 1)
+    return std::find_if(larger.begin(), 
+                        larger.end(), 
+                        compareNodeWith<std::equal_to<string_type>, string_type, string_adaptor>(nodeStringValue<string_type, string_adaptor>(smaller[0]))) != larger.end();
 
-  ++l;
-  predicate2 p2;
-  for(typename NodeSet<string_type, string_adaptor>::const_iterator lend = lns.end(); l != lend; ++l)
-    if(p2(values.find(nodeStringValue<string_type, string_adaptor>(*l)),  values.end()))
+  std::unordered_set<string_type, hashStringValue<string_type, string_adaptor> > values(smaller.size());
+  for(typename NodeSetT::const_iterator s = smaller.begin(), se = smaller.end(); s != se; ++s)
+    values.insert(nodeStringValue<string_type, string_adaptor>(*s));
+
+  for(typename NodeSetT::const_iterator l = larger.begin(), le = larger.end(); l != le; ++l)
+    if(values.find(nodeStringValue<string_type, string_adaptor>(*l)) != values.end())
       return true;
 
   return false;
 } // nodeSetsEqual
 
-template<class string_type, class string_adaptor>
-bool nodeSetsEqual(const XPathValue<string_type, string_adaptor>& lhs, const XPathValue<string_type, string_adaptor>& rhs)
-{
-  return nodeSetsCompare<string_type, string_adaptor, 
-                         std::equal_to<string_type>,
-                         std::not_equal_to<typename std::set<string_type>::const_iterator> >(lhs, rhs);
-}
-
 template<class string_type, class string_adaptor>
 bool nodeSetsNotEqual(const XPathValue<string_type, string_adaptor>& lhs, const XPathValue<string_type, string_adaptor>& rhs)
 {
-  return nodeSetsCompare<string_type, string_adaptor, 
-                         std::not_equal_to<string_type>,
-                         std::equal_to<typename std::set<string_type>::const_iterator> >(lhs, rhs);
-}
+  typedef NodeSet<string_type, string_adaptor> NodeSetT;
+  const NodeSetT& lns = lhs.asNodeSet();
+  const NodeSetT& rns = rhs.asNodeSet();
+
+  if((lns.size() == 0) || (rns.size() == 0))
+    return false;
+
+  // some pair differs unless every node in both sets has the same string-value
+  const string_type first = nodeStringValue<string_type, string_adaptor>(lns[0]);
+  compareNodeWith<std::not_equal_to<string_type>, string_type, string_adaptor> differs(first);
+  return (std::find_if(rns.begin(), rns.end(), differs) != rns.end()) ||
+         (std::find_if(lns.begin() + 1, lns.end(), differs) != lns.end());
+} // nodeSetsNotEqual
 
 template<class string_type, class string_adaptor>
 bool nodeSetAndValueEqual(const XPathValue<string_type, string_adaptor>& lhs, const XPathValue<string_type, string_adaptor>& rhs)
@@ -637,7 +818,7 @@ template<class string_type, class string_adaptor>
 double minValue(const NodeSet<string_type, string_adaptor>& ns)
 {
   double v = nodeNumberValue<string_type, string_adaptor>(ns[0]);
-  for(typename NodeSet<string_type, string_adaptor>::const_iterator i = ns.begin(), ie = ns.end(); i != ie; ++i)
+  for(typename NodeSet<string_type, string_adaptor>::const_iterator i = ns.begin() + 1, ie = ns.end(); i != ie; ++i)
   {
     double vt = nodeNumberValue<string_type, string_adaptor>(*i);
     if(isNaN(vt))
@@ -652,7 +833,7 @@ template<class string_type, class string_adaptor>
 double maxValue(const NodeSet<string_type, string_adaptor>& ns)
 {
   double v = nodeNumberValue<string_type, string_adaptor>(ns[0]);
-  for(typename NodeSet<string_type, string_adaptor>::const_iterator i = ns.begin(), ie = ns.end(); i != ie; ++i)
+  for(typename NodeSet<string_type, string_adaptor>::const_iterator i = ns.begin() + 1, ie = ns.end(); i != ie; ++i)
   {
     double vt = nodeNumberValue<string_type, string_adaptor>(*i);
     if(isNaN(vt))
@@ -666,7 +847,12 @@ double maxValue(const NodeSet<string_type, string_adaptor>& ns)
 template<class Op, class string_type, class string_adaptor>
 bool compareNodeSets(const XPathValue<string_type, string_adaptor>& lhs, const XPathValue<string_type, string_adaptor>& rhs)
 {
-  return Op()(minValue<string_type, string_adaptor>(lhs.asNodeSet()), maxValue<string_type, string_adaptor>(rhs.asNodeSet()));
+  // some pair satisfies Op exactly when the lhs minimum and the rhs maximum do
+  const NodeSet<string_type, string_adaptor>& lns = lhs.asNodeSet();
+  const NodeSet<string_type, string_adaptor>& rns = rhs.asNodeSet();
+  if((lns.size() == 0) || (rns.size() == 0))
+    return false;
+  return Op()(minValue<string_type, string_adaptor>(lns), maxValue<string_type, string_adaptor>(rns));
 } // compareNodeSets
 
 template<class Op, class string_type, class string_adaptor>
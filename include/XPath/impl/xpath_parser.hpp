@@ -55,6 +55,7 @@ namespace impl
   template<class string_type, class string_adaptor> class CompilationContext;
 
   template<class string_type, class string_adaptor> class StepExpression;
+  template<class string_type, class string_adaptor> class BytecodeExpression;
 
   template<class string_type, class string_adaptor>
   class StepList : public std::deque<impl::StepExpression<string_type, string_adaptor>*> { };
@@ -78,12 +79,12 @@ public:
 
   XPathExpression<string_type, string_adaptor> compile(const string_type& xpath) const
   {
-    return do_compile(xpath, &XPath::parse_xpath, expression_factory());
+    return do_compile(xpath, &XPath::parse_xpath, expression_factory(), true);
   } // compile
 
   XPathExpression<string_type, string_adaptor> compile_expr(const string_type& xpath) const
   {
-    return do_compile(xpath, &XPath::parse_xpath_expr, expression_factory());
+    return do_compile(xpath, &XPath::parse_xpath_expr, expression_factory(), true);
   } // compile_expr
 
   XPathExpression<string_type, string_adaptor> compile_attribute_value_template(const string_type& xpath) const
@@ -139,7 +140,8 @@ private:
 
   XPathExpression<string_type, string_adaptor> do_compile(const string_type& xpath,
                                                              parserFn parser,
-                                                             const std::map<int, compileFn>& factory) const
+                                                             const std::map<int, compileFn>& factory,
+                                                             bool bytecode = false) const
   {
     typename impl::types<string_adaptor>::tree_info_t ast;
     try {
@@ -153,10 +155,13 @@ private:
 								    getVariableCompileTimeResolver());
 
       //XPath::dump(ast.trees.begin(), 0);
-      return XPathExpression<string_type, string_adaptor>(compile_with_factory(ast.trees.begin(),
-                                                                                  ast.trees.end(),
-                                                                                  context,
-                                                                                  factory));
+      XPathExpression_impl<string_type, string_adaptor>* expr = compile_with_factory(ast.trees.begin(),
+                                                                                     ast.trees.end(),
+                                                                                     context,
+                                                                                     factory);
+      if(bytecode)
+        expr = impl::BytecodeExpression<string_type, string_adaptor>::create(expr);
+      return XPathExpression<string_type, string_adaptor>(expr);
     } // try
     catch(const std::exception&)
     {
@@ -263,6 +268,10 @@ private:
   static XPathExpression_impl<string_type, string_adaptor>* createUnaryExpression(typename impl::types<string_adaptor>::node_iter_t const& i, typename impl::types<string_adaptor>::node_iter_t const& ie, impl::CompilationContext<string_type, string_adaptor>& context);
   static XPathExpression_impl<string_type, string_adaptor>* createUnaryNegativeExpr(typename impl::types<string_adaptor>::node_iter_t const& i, typename impl::types<string_adaptor>::node_iter_t const& ie, impl::CompilationContext<string_type, string_adaptor>& context);
 
+  static bool isConstant(const XPathExpression_impl<string_type, string_adaptor>* expr);
+  static XPathExpression_impl<string_type, string_adaptor>* createConstant(const XPathValue<string_type, string_adaptor>& value);
+  static XPathExpression_impl<string_type, string_adaptor>* fold(XPathExpression_impl<string_type, string_adaptor>* expr);
+
   static impl::StepList<string_type, string_adaptor> createStepList(typename impl::types<string_adaptor>::node_iter_t const& from, typename impl::types<string_adaptor>::node_iter_t const& to, impl::CompilationContext<string_type, string_adaptor>& context);
 
   static XPathExpression_impl<string_type, string_adaptor>* createDocMatch(typename impl::types<string_adaptor>::node_iter_t const& i, typename impl::types<string_adaptor>::node_iter_t const& ie, impl::CompilationContext<string_type, string_adaptor>& context);
@@ -545,7 +554,9 @@ namespace XPath
 template<class string_type, class string_adaptor>
 XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_adaptor>::createAbsoluteLocationPath(typename impl::types<string_adaptor>::node_iter_t const& i, typename impl::types<string_adaptor>::node_iter_t const& /* ie */, impl::CompilationContext<string_type, string_adaptor>& context)
 {
-  return new impl::AbsoluteLocationPath<string_type, string_adaptor>(createStepList(i->children.begin(), i->children.end(), context));
+  impl::StepList<string_type, string_adaptor> steps = createStepList(i->children.begin(), i->children.end(), context);
+  impl::StepFactory<string_type, string_adaptor>::useNameIndex(steps);
+  return new impl::AbsoluteLocationPath<string_type, string_adaptor>(steps);
 } // createAbsoluteLocationPath
 
 template<class string_type, class string_adaptor>
@@ -610,7 +621,14 @@ XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_ada
   } // while ...
   // maybe trailing whitespace ...
 
-  return impl::FunctionHolder<string_type, string_adaptor>::createFunction(namespace_uri, name, args, context);
+  XPathExpression_impl<string_type, string_adaptor>* fn = impl::FunctionHolder<string_type, string_adaptor>::createFunction(namespace_uri, name, args, context);
+
+  if(!StandardXPathFunctionResolver<string_type, string_adaptor>::isFoldable(namespace_uri, name, args.size()))
+    return fn;
+  for(typename std::vector<XPathExpression<string_type, string_adaptor> >::const_iterator a = args.begin(), ae = args.end(); a != ae; ++a)
+    if(!isConstant(a->get()))
+      return fn;
+  return fold(fn);
 } // createFunction
 
 template<class string_type, class string_adaptor>
@@ -626,6 +644,21 @@ XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_ada
     ++c;
     XPathExpression_impl<string_type, string_adaptor>* p2 = XPath<string_type, string_adaptor>::compile_expression(c, i->children.end(), context);
 
+    // the right operand of or/and is never looked at if the left decides it
+    if(((op == impl::OrOperator_id) || (op == impl::AndOperator_id)) && isConstant(p1))
+    {
+      bool lhs = p1->evaluateAsBool(DOM::Node<string_type, string_adaptor>(), ExecutionContext<string_type, string_adaptor>());
+      if(lhs == (op == impl::OrOperator_id))
+      {
+        delete p1;
+        delete p2;
+        p1 = createConstant(BoolValue<string_type, string_adaptor>::createValue(lhs));
+        continue;
+      } // if ...
+    } // if ...
+
+    bool constant = (op != impl::UnionOperator_id) && isConstant(p1) && isConstant(p2);
+
     switch(op)
     {
       case impl::PlusOperator_id:
@@ -673,6 +706,9 @@ XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_ada
       default:
         throw UnsupportedException(boost::lexical_cast<std::string>(op));
     } // switch
+
+    if(constant)
+      p1 = fold(p1);
   }
   while(++c != i->children.end());
 
@@ -683,14 +719,14 @@ template<class string_type, class string_adaptor>
 XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_adaptor>::createLiteral(typename impl::types<string_adaptor>::node_iter_t const& i, typename impl::types<string_adaptor>::node_iter_t const& /* ie */, impl::CompilationContext<string_type, string_adaptor>& /* context */)
 {
   string_type str = string_adaptor::construct(i->value.begin(), i->value.end());
-  return new StringValue<string_type, string_adaptor>(str);
+  return createConstant(StringValue<string_type, string_adaptor>::createValue(str));
 } // createLiteral
 
 template<class string_type, class string_adaptor>
 XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_adaptor>::createNumber(typename impl::types<string_adaptor>::node_iter_t const& i, typename impl::types<string_adaptor>::node_iter_t const& /* ie */, impl::CompilationContext<string_type, string_adaptor>& /* context */)
 {
   string_type str = string_adaptor::construct(i->value.begin(), i->value.end());
-  return new NumericValue<string_type, string_adaptor>(boost::lexical_cast<double>(str));
+  return createConstant(NumericValue<string_type, string_adaptor>::createValue(boost::lexical_cast<double>(str)));
 } // createNumber
 
 template<class string_type, class string_adaptor>
@@ -730,9 +766,42 @@ XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_ada
 template<class string_type, class string_adaptor>
 XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_adaptor>::createUnaryNegativeExpr(typename impl::types<string_adaptor>::node_iter_t const& i, typename impl::types<string_adaptor>::node_iter_t const& ie, impl::CompilationContext<string_type, string_adaptor>& context)
 {
-  return new impl::UnaryNegative<string_type, string_adaptor>(XPath<string_type, string_adaptor>::compile_expression(i+1, ie, context));
+  XPathExpression_impl<string_type, string_adaptor>* expr = XPath<string_type, string_adaptor>::compile_expression(i+1, ie, context);
+  bool constant = isConstant(expr);
+  XPathExpression_impl<string_type, string_adaptor>* negative = new impl::UnaryNegative<string_type, string_adaptor>(expr);
+  return constant ? fold(negative) : negative;
 } // createUnaryNegativeExpr
 
+template<class string_type, class string_adaptor>
+bool XPath<string_type, string_adaptor>::isConstant(const XPathExpression_impl<string_type, string_adaptor>* expr)
+{
+  return dynamic_cast<const impl::ConstantValue<string_type, string_adaptor>*>(expr) != 0;
+} // isConstant
+
+template<class string_type, class string_adaptor>
+XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_adaptor>::createConstant(const XPathValue<string_type, string_adaptor>& value)
+{
+  return new impl::ConstantValue<string_type, string_adaptor>(value);
+} // createConstant
+
+// expr has no dependence on the context, so evaluate it once now and 
+// keep the value in its place
+template<class string_type, class string_adaptor>
+XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_adaptor>::fold(XPathExpression_impl<string_type, string_adaptor>* expr)
+{
+  XPathValue<string_type, string_adaptor> value;
+  try {
+    value = expr->evaluate(DOM::Node<string_type, string_adaptor>(), ExecutionContext<string_type, string_adaptor>());
+  } // try
+  catch(...)
+  {
+    delete expr;
+    throw;
+  } // catch
+  delete expr;
+  return createConstant(value);
+} // fold
+
 template<class string_type, class string_adaptor>
 impl::StepList<string_type, string_adaptor> XPath<string_type, string_adaptor>::createStepList(typename impl::types<string_adaptor>::node_iter_t const& from,
                                                             typename impl::types<string_adaptor>::node_iter_t const& to,
@@ -1010,10 +1079,21 @@ XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_ada
   for(typename impl::types<string_adaptor>::node_iter_t a = i->children.begin(), e = i->children.end(); a != e; ++a)
   {
     XPathExpression<string_type, string_adaptor> arg(XPath<string_type, string_adaptor>::compile_attribute_value(a, e, context));
+    // run together neighbouring literal text, including {{ and }}
+    if(isConstant(arg.get()) && !args.empty() && isConstant(args.back().get()))
+    {
+      string_type text = args.back().evaluateAsString(DOM::Node<string_type, string_adaptor>());
+      string_adaptor::append(text, arg.evaluateAsString(DOM::Node<string_type, string_adaptor>()));
+      args.back() = XPathExpression<string_type, string_adaptor>(createConstant(StringValue<string_type, string_adaptor>::createValue(text)));
+      continue;
+    } // if ...
     args.push_back(arg);
   } // while ...
   // maybe trailing whitespace ...
 
+  if((args.size() == 1) && isConstant(args[0].get()))
+    return createConstant(StringValue<string_type, string_adaptor>::createValue(args[0].evaluateAsString(DOM::Node<string_type, string_adaptor>())));
+
   return impl::FunctionHolder<string_type, string_adaptor>::createFunction(string_adaptor::construct_from_utf8(""),
                                                                            string_adaptor::construct_from_utf8("concat"),
                                                                            args,
@@ -1029,13 +1109,13 @@ XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_ada
 template<class string_type, class string_adaptor>
 XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_adaptor>::createDoubleLeftCurly(typename impl::types<string_adaptor>::node_iter_t const& /* i */, typename impl::types<string_adaptor>::node_iter_t const& /* ie */, impl::CompilationContext<string_type, string_adaptor>& /* context */)
 {
-  return new StringValue<string_type, string_adaptor>("{");
+  return createConstant(StringValue<string_type, string_adaptor>::createValue(string_adaptor::construct_from_utf8("{")));
 } // createDoubleLeftCurly
 
 template<class string_type, class string_adaptor>
 XPathExpression_impl<string_type, string_adaptor>* XPath<string_type, string_adaptor>::createDoubleRightCurly(typename impl::types<string_adaptor>::node_iter_t const& /* i */, typename impl::types<string_adaptor>::node_iter_t const& /* ie */, impl::CompilationContext<string_type, string_adaptor>& /* context */)
 {
-  return new StringValue<string_type, string_adaptor>("}");
+  return createConstant(StringValue<string_type, string_adaptor>::createValue(string_adaptor::construct_from_utf8("}")));
 } // createDoubleRightCurly
 
 
@@ -1,6 +1,7 @@
 #ifndef ARABICA_XPATHIC_XPATH_RELATIONAL_HPP
 #define ARABICA_XPATHIC_XPATH_RELATIONAL_HPP
 
+#include <functional>
 #include "xpath_value.hpp"
 
 namespace Arabica
@@ -11,120 +12,185 @@ namespace impl
 {
 
 template<class string_type, class string_adaptor>
-class EqualsOperator : public BinaryExpression<string_type, string_adaptor>
+class RelationalOperator : public BinaryExpression<string_type, string_adaptor>
 {
   typedef BinaryExpression<string_type, string_adaptor> baseT;
 public:
-  EqualsOperator(XPathExpression_impl<string_type, string_adaptor>* lhs,   
-                 XPathExpression_impl<string_type, string_adaptor>* rhs) :
-       BinaryExpression<string_type, string_adaptor>(lhs, rhs) { }
+  using BinaryExpression<string_type, string_adaptor>::evaluateAsBool;
 
   virtual ValueType type() const { return BOOL; }
 
   virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
-                                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+                                                           const ExecutionContext<string_type, string_adaptor>& executionContext) const 
   {
-    return BoolValue<string_type, string_adaptor>::createValue(areEqual<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
-                                           baseT::rhs()->evaluate(context, executionContext)));
+    return BoolValue<string_type, string_adaptor>::createValue(evaluateAsBool(context, executionContext));
   } // evaluate
+
+protected:
+  // When neither operand can be a node-set, the comparison type is known
+  // now and both sides can be evaluated directly as that type. ANY means
+  // it has to wait for the values.
+  RelationalOperator(XPathExpression_impl<string_type, string_adaptor>* lhs,   
+                     XPathExpression_impl<string_type, string_adaptor>* rhs,
+                     bool equality) :
+       BinaryExpression<string_type, string_adaptor>(lhs, rhs),
+       compareAs_(ANY)
+  { 
+    ValueType lt = lhs->type();
+    ValueType rt = rhs->type();
+    if((lt == ANY) || (lt == NODE_SET) || (rt == ANY) || (rt == NODE_SET))
+      return;
+
+    if(!equality)
+      compareAs_ = NUMBER;
+    else if((lt == BOOL) || (rt == BOOL))
+      compareAs_ = BOOL;
+    else if((lt == NUMBER) || (rt == NUMBER))
+      compareAs_ = NUMBER;
+    else
+      compareAs_ = STRING;
+  } // RelationalOperator
+
+  bool scalarsEqual(const DOM::Node<string_type, string_adaptor>& context, 
+                    const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    switch(compareAs_)
+    {
+      case BOOL:
+        return baseT::lhs()->evaluateAsBool(context, executionContext) == baseT::rhs()->evaluateAsBool(context, executionContext);
+      case NUMBER:
+        return baseT::lhs()->evaluateAsNumber(context, executionContext) == baseT::rhs()->evaluateAsNumber(context, executionContext);
+      default:
+        return baseT::lhs()->evaluateAsString(context, executionContext) == baseT::rhs()->evaluateAsString(context, executionContext);
+    } // switch
+  } // scalarsEqual
+
+  template<class Op>
+  bool compareNumbers(const DOM::Node<string_type, string_adaptor>& context, 
+                      const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return Op()(baseT::lhs()->evaluateAsNumber(context, executionContext), baseT::rhs()->evaluateAsNumber(context, executionContext));
+  } // compareNumbers
+
+  ValueType compareAs_;
+}; // class RelationalOperator
+
+template<class string_type, class string_adaptor>
+class EqualsOperator : public RelationalOperator<string_type, string_adaptor>
+{
+  typedef RelationalOperator<string_type, string_adaptor> baseT;
+public:
+  EqualsOperator(XPathExpression_impl<string_type, string_adaptor>* lhs, 
+                 XPathExpression_impl<string_type, string_adaptor>* rhs) :
+      RelationalOperator<string_type, string_adaptor>(lhs, rhs, true) { }
+
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context, 
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    if(baseT::compareAs_ != ANY)
+      return baseT::scalarsEqual(context, executionContext);
+    return areEqual<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
+                                             baseT::rhs()->evaluate(context, executionContext));
+  } // evaluateAsBool
 }; // class EqualsOperator
 
 template<class string_type, class string_adaptor>
-class NotEqualsOperator : public BinaryExpression<string_type, string_adaptor>
+class NotEqualsOperator : public RelationalOperator<string_type, string_adaptor>
 {
-  typedef BinaryExpression<string_type, string_adaptor> baseT;
+  typedef RelationalOperator<string_type, string_adaptor> baseT;
 public:
   NotEqualsOperator(XPathExpression_impl<string_type, string_adaptor>* lhs, 
                     XPathExpression_impl<string_type, string_adaptor>* rhs) :
-       BinaryExpression<string_type, string_adaptor>(lhs, rhs) { }
-
-  virtual ValueType type() const { return BOOL; }
+      RelationalOperator<string_type, string_adaptor>(lhs, rhs, true) { }
 
-  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
-                                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context, 
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
   {
-    return BoolValue<string_type, string_adaptor>::createValue(areNotEqual<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
-                                            baseT::rhs()->evaluate(context, executionContext)));
-  } // evaluate
+    if(baseT::compareAs_ != ANY)
+      return !baseT::scalarsEqual(context, executionContext);
+    return areNotEqual<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
+                                                baseT::rhs()->evaluate(context, executionContext));
+  } // evaluateAsBool
 }; // class NotEqualsOperator
 
 template<class string_type, class string_adaptor>
-class LessThanOperator : public BinaryExpression<string_type, string_adaptor>
+class LessThanOperator : public RelationalOperator<string_type, string_adaptor>
 {
-  typedef BinaryExpression<string_type, string_adaptor> baseT;
+  typedef RelationalOperator<string_type, string_adaptor> baseT;
 public:
   LessThanOperator(XPathExpression_impl<string_type, string_adaptor>* lhs, 
                    XPathExpression_impl<string_type, string_adaptor>* rhs) :
-      BinaryExpression<string_type, string_adaptor>(lhs, rhs) { }
-
-  virtual ValueType type() const { return BOOL; }
+      RelationalOperator<string_type, string_adaptor>(lhs, rhs, false) { }
 
-  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
-                                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context, 
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
   {
-    return BoolValue<string_type, string_adaptor>::createValue(isLessThan<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
-                                             baseT::rhs()->evaluate(context, executionContext)));
-  } // evaluate
+    if(baseT::compareAs_ != ANY)
+      return baseT::template compareNumbers<std::less<double> >(context, executionContext);
+    return isLessThan<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
+                                               baseT::rhs()->evaluate(context, executionContext));
+  } // evaluateAsBool
 }; // class LessThanOperator
 
 template<class string_type, class string_adaptor>
-class LessThanEqualsOperator : public BinaryExpression<string_type, string_adaptor>
+class LessThanEqualsOperator : public RelationalOperator<string_type, string_adaptor>
 {
-  typedef BinaryExpression<string_type, string_adaptor> baseT;
+  typedef RelationalOperator<string_type, string_adaptor> baseT;
 public:
   LessThanEqualsOperator(XPathExpression_impl<string_type, string_adaptor>* lhs, 
                          XPathExpression_impl<string_type, string_adaptor>* rhs) :
-      BinaryExpression<string_type, string_adaptor>(lhs, rhs) { }
-
-  virtual ValueType type() const { return BOOL; }
+      RelationalOperator<string_type, string_adaptor>(lhs, rhs, false) { }
 
-  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
-                                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context, 
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
   {
-    return BoolValue<string_type, string_adaptor>::createValue(isLessThanEquals<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
-                                                   baseT::rhs()->evaluate(context, executionContext)));
-  } // evaluate
+    if(baseT::compareAs_ != ANY)
+      return baseT::template compareNumbers<std::less_equal<double> >(context, executionContext);
+    return isLessThanEquals<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
+                                                     baseT::rhs()->evaluate(context, executionContext));
+  } // evaluateAsBool
 }; // class LessThanEqualsOperator
 
 template<class string_type, class string_adaptor>
-class GreaterThanOperator : public BinaryExpression<string_type, string_adaptor>
+class GreaterThanOperator : public RelationalOperator<string_type, string_adaptor>
 {
-  typedef BinaryExpression<string_type, string_adaptor> baseT;
+  typedef RelationalOperator<string_type, string_adaptor> baseT;
 public:
   GreaterThanOperator(XPathExpression_impl<string_type, string_adaptor>* lhs, 
                       XPathExpression_impl<string_type, string_adaptor>* rhs) :
-      BinaryExpression<string_type, string_adaptor>(lhs, rhs) { }
+      RelationalOperator<string_type, string_adaptor>(lhs, rhs, false) { }
 
-  virtual ValueType type() const { return BOOL; }
-
-  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
-                                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context, 
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
   {
-    return BoolValue<string_type, string_adaptor>::createValue(isGreaterThan<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
-                                                baseT::rhs()->evaluate(context, executionContext)));
-  } // evaluate
+    if(baseT::compareAs_ != ANY)
+      return baseT::template compareNumbers<std::greater<double> >(context, executionContext);
+    return isGreaterThan<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
+                                                  baseT::rhs()->evaluate(context, executionContext));
+  } // evaluateAsBool
 }; // class GreaterThanOperator
 
 template<class string_type, class string_adaptor>
-class GreaterThanEqualsOperator : public BinaryExpression<string_type, string_adaptor>
+class GreaterThanEqualsOperator : public RelationalOperator<string_type, string_adaptor>
 {
-  typedef BinaryExpression<string_type, string_adaptor> baseT;
+  typedef RelationalOperator<string_type, string_adaptor> baseT;
 public:
   GreaterThanEqualsOperator(XPathExpression_impl<string_type, string_adaptor>* lhs, 
                             XPathExpression_impl<string_type, string_adaptor>* rhs) :
-      BinaryExpression<string_type, string_adaptor>(lhs, rhs) { }
+      RelationalOperator<string_type, string_adaptor>(lhs, rhs, false) { }
 
-  virtual ValueType type() const { return BOOL; }
-
-  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
-                                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context, 
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
   {
-    return BoolValue<string_type, string_adaptor>::createValue(isGreaterThanEquals<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
-                                                      baseT::rhs()->evaluate(context, executionContext)));
-  } // evaluate
+    if(baseT::compareAs_ != ANY)
+      return baseT::template compareNumbers<std::greater_equal<double> >(context, executionContext);
+    return isGreaterThanEquals<string_type, string_adaptor>(baseT::lhs()->evaluate(context, executionContext),
+                                                        baseT::rhs()->evaluate(context, executionContext));
+  } // evaluateAsBool
 }; // class GreaterThanEqualsOperator
 
 } // namespace impl
 } // namespace XPath
 } // namespace Arabica
-#endif 
+
+#endif
@@ -11,6 +11,11 @@
 #include "xpath_ast_ids.hpp"
 #include "xpath_namespace_context.hpp"
 #include "xpath_compile_context.hpp"
+#include "xpath_function_holder.hpp"
+#include "xpath_relational.hpp"
+#include "xpath_variable.hpp"
+#include "xpath_bytecode.hpp"
+#include <DOM/Simple/DocumentImpl.hpp>
 
 namespace Arabica
 {
@@ -27,9 +32,9 @@ template<class string_type, class string_adaptor>
 class StepExpression : public XPathExpression_impl<string_type, string_adaptor>
 {
 public:
-  StepExpression() { }
-  StepExpression(XPathExpression_impl<string_type, string_adaptor>* pred) { predicates_.push_back(pred); }
-  StepExpression(const std::vector<XPathExpression_impl<string_type, string_adaptor> *>& predicates) : predicates_(predicates) { }
+  StepExpression() : positional_(NOT_POSITIONAL), nth_(0) { }
+  StepExpression(XPathExpression_impl<string_type, string_adaptor>* pred) { predicates_.push_back(pred); analysePredicates(); }
+  StepExpression(const std::vector<XPathExpression_impl<string_type, string_adaptor> *>& predicates) : predicates_(predicates) { analysePredicates(); }
 
   virtual ~StepExpression()
   { 
@@ -43,33 +48,85 @@ public:
   virtual XPathValue<string_type, string_adaptor> evaluate(NodeSet<string_type, string_adaptor>& context, const ExecutionContext<string_type, string_adaptor>& executionContext) const = 0;
 
   bool has_predicates() const { return !predicates_.empty(); }
+  const std::vector<XPathExpression_impl<string_type, string_adaptor>*>& predicates() const { return predicates_; }
 
 protected:
-  NodeSet<string_type, string_adaptor> applyPredicates(NodeSet<string_type, string_adaptor>& nodes, const ExecutionContext<string_type, string_adaptor>& parentContext) const
+  // Set when the first predicate picks out a single node by position - 
+  // [3] or [last()] - so the axis can be searched for just that node.
+  enum Positional { NOT_POSITIONAL, NTH, LAST };
+  Positional positional() const { return positional_; }
+  size_t nth() const { return nth_; }
+
+  NodeSet<string_type, string_adaptor> applyPredicates(NodeSet<string_type, string_adaptor>& nodes, const ExecutionContext<string_type, string_adaptor>& parentContext, size_t first = 0) const
   {
-    for(typename std::vector<XPathExpression_impl<string_type, string_adaptor>*>::const_iterator p = predicates_.begin(), e = predicates_.end();
-        (p != e) && (!nodes.empty()); ++p)
-      nodes = applyPredicate(nodes, *p, parentContext);
+    for(size_t p = first, e = predicates_.size(); (p != e) && (!nodes.empty()); ++p)
+      nodes = applyPredicate(nodes, predicates_[p], code_[p], parentContext);
     return nodes;
   } // applyPredicates
 
 private:
+  void analysePredicates()
+  {
+    code_.clear();
+    for(typename std::vector<XPathExpression_impl<string_type, string_adaptor>*>::const_iterator p = predicates_.begin(), e = predicates_.end(); p != e; ++p)
+      code_.push_back(Bytecode<string_type, string_adaptor>(*p));
+
+    positional_ = NOT_POSITIONAL;
+    nth_ = 0;
+    if(predicates_.empty())
+      return;
+
+    const XPathExpression_impl<string_type, string_adaptor>* first = predicates_[0];
+    const ConstantValue<string_type, string_adaptor>* number = dynamic_cast<const ConstantValue<string_type, string_adaptor>*>(first);
+    if((number != 0) && (number->type() == NUMBER))
+    {
+      double n = number->value().asNumber();
+      if((n >= 1) && (n == std::floor(n)) && (n < 4294967296.0))
+      {
+        positional_ = NTH;
+        nth_ = static_cast<size_t>(n);
+      } // if ...
+      return;
+    } // if ...
+
+    const FunctionHolder<string_type, string_adaptor>* fn = dynamic_cast<const FunctionHolder<string_type, string_adaptor>*>(first);
+    if((fn != 0) && string_adaptor::empty(fn->namespace_uri()) && (fn->name() == string_adaptor::construct_from_utf8("last")))
+      positional_ = LAST;
+  } // analysePredicates
+
   NodeSet<string_type, string_adaptor> applyPredicate(NodeSet<string_type, string_adaptor>& nodes, 
                                       XPathExpression_impl<string_type, string_adaptor>* predicate, 
+                                      const Bytecode<string_type, string_adaptor>& code,
                                       const ExecutionContext<string_type, string_adaptor>& parentContext) const
   {
     ExecutionContext<string_type, string_adaptor> executionContext(nodes.size(), parentContext);
     NodeSet<string_type, string_adaptor> results(nodes.forward());
+    const ValueType type = predicate->type();
     unsigned int position = 1;
     for(typename NodeSet<string_type, string_adaptor>::iterator i = nodes.begin(); i != nodes.end(); ++i, ++position)
     {
       executionContext.setPosition(position);
-      XPathValue<string_type, string_adaptor> v = predicate->evaluate(*i, executionContext);
-
-      if((v.type() == NUMBER) && (position != v.asNumber()))
-        continue;
-      if(v.asBool() == false)
-        continue;
+      if(type == NUMBER)
+      {
+        double n = code.compiled() ? code.evaluateAsNumber(*i, executionContext) : predicate->evaluateAsNumber(*i, executionContext);
+        if(position != n)
+          continue;
+      } 
+      else if(type != ANY)
+      {
+        bool b = code.compiled() ? code.evaluateAsBool(*i, executionContext) : predicate->evaluateAsBool(*i, executionContext);
+        if(b == false)
+          continue;
+      }
+      else
+      {
+        XPathValue<string_type, string_adaptor> v = predicate->evaluate(*i, executionContext);
+
+        if((v.type() == NUMBER) && (position != v.asNumber()))
+          continue;
+        if(v.asBool() == false)
+          continue;
+      } // if ...
 
       results.push_back(*i);
     } // for ...
@@ -77,6 +134,9 @@ private:
   } // applyPredicate
   
   std::vector<XPathExpression_impl<string_type, string_adaptor>*> predicates_;
+  std::vector<Bytecode<string_type, string_adaptor> > code_;
+  Positional positional_;
+  size_t nth_;
 
   friend class MatchExpr<string_type, string_adaptor>;
 }; // StepExpression
@@ -114,6 +174,9 @@ public:
     delete test_;
   } // StepExpression
 
+  Axis axis() const { return axis_; }
+  const NodeTest<string_type, string_adaptor>* test() const { return test_; }
+
   virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, const ExecutionContext<string_type, string_adaptor>& executionContext) const
   {
     NodeSet<string_type, string_adaptor> nodes;
@@ -129,6 +192,19 @@ public:
     return XPathValue<string_type, string_adaptor>(new NodeSetValue<string_type, string_adaptor>(nodes));
   } // evaluate
 
+  virtual bool stream(const DOM::Node<string_type, string_adaptor>& context, 
+                      const ExecutionContext<string_type, string_adaptor>& executionContext,
+                      NodeVisitor<string_type, string_adaptor>& visitor) const
+  {
+    if(baseT::has_predicates())
+      return baseT::stream(context, executionContext, visitor);
+
+    for(AxisEnumerator<string_type, string_adaptor> enumerator(context, axis_); *enumerator != 0; ++enumerator)
+      if((*test_)(*enumerator) && !visitor.visit(*enumerator))
+        return false;
+    return true;
+  } // stream
+
 private:
   void enumerateOver(const DOM::Node<string_type, string_adaptor>& context, 
                      NodeSet<string_type, string_adaptor>& results, 
@@ -137,6 +213,19 @@ private:
     AxisEnumerator<string_type, string_adaptor> enumerator(context, axis_);
     results.forward(enumerator.forward());
     NodeSet<string_type, string_adaptor> intermediate(enumerator.forward());
+    if(baseT::positional() != baseT::NOT_POSITIONAL)
+    {
+      DOM::Node<string_type, string_adaptor> node = (baseT::positional() == baseT::NTH) ? 
+                                                       findNth(enumerator, baseT::nth()) : 
+                                                       findLast(context, enumerator);
+      if(node == 0)
+        return;
+      intermediate.push_back(node);
+      intermediate = baseT::applyPredicates(intermediate, parentContext, 1);
+      results.insert(results.end(), intermediate.begin(), intermediate.end());
+      return;
+    } // if ...
+
     NodeSet<string_type, string_adaptor>& d = (!baseT::has_predicates()) ? results : intermediate;
     while(*enumerator != 0)
     {
@@ -155,6 +244,86 @@ private:
     results.insert(results.end(), intermediate.begin(), intermediate.end());
   } // enumerateOver
 
+  DOM::Node<string_type, string_adaptor> findNth(AxisEnumerator<string_type, string_adaptor>& enumerator, size_t n) const
+  {
+    for(size_t count = 0; *enumerator != 0; ++enumerator)
+      if((*test_)(*enumerator) && (++count == n))
+        return *enumerator;
+    return DOM::Node<string_type, string_adaptor>();
+  } // findNth
+
+  DOM::Node<string_type, string_adaptor> findLast(const DOM::Node<string_type, string_adaptor>& context, 
+                                                  AxisEnumerator<string_type, string_adaptor>& enumerator) const
+  {
+    // The sibling axes can be searched from the far end.  Adjacent text
+    // nodes count as one, which makes a text context's siblings awkward, so
+    // they and everything else get the long way round.
+    if(!isText(context) && (context.getNodeType() != DOM::Node_base::ATTRIBUTE_NODE))
+    {
+      if(axis_ == CHILD)
+        return searchBack(context.getLastChild(), context.getFirstChild());
+      if(axis_ == FOLLOWING_SIBLING)
+        return (context.getNextSibling() != 0) ? 
+                  searchBack(context.getParentNode().getLastChild(), context.getNextSibling()) : 
+                  DOM::Node<string_type, string_adaptor>();
+      if(axis_ == PRECEDING_SIBLING)
+        return (context.getPreviousSibling() != 0) ? 
+                  searchForward(context.getParentNode().getFirstChild(), context) :
+                  DOM::Node<string_type, string_adaptor>();
+    } // if ...
+
+    DOM::Node<string_type, string_adaptor> last;
+    for( ; *enumerator != 0; ++enumerator)
+      if((*test_)(*enumerator))
+        last = *enumerator;
+    return last;
+  } // findLast
+
+  // walks back from node to stop, inclusive, as the child axis would see them
+  DOM::Node<string_type, string_adaptor> searchBack(DOM::Node<string_type, string_adaptor> node, 
+                                                    const DOM::Node<string_type, string_adaptor>& stop) const
+  {
+    for(node = runStart(node); node != 0; node = runStart(node.getPreviousSibling()))
+    {
+      if((*test_)(node))
+        return node;
+      if(node == stop)
+        break;
+    } // for ...
+    return DOM::Node<string_type, string_adaptor>();
+  } // searchBack
+
+  // walks forward from node up to, but not including, stop
+  DOM::Node<string_type, string_adaptor> searchForward(DOM::Node<string_type, string_adaptor> node, 
+                                                       const DOM::Node<string_type, string_adaptor>& stop) const
+  {
+    while((node != 0) && (node != stop))
+    {
+      if((*test_)(node))
+        return node;
+      bool text = isText(node);
+      node = node.getNextSibling();
+      while(text && (node != 0) && isText(node))
+        node = node.getNextSibling();
+    } // while ...
+    return DOM::Node<string_type, string_adaptor>();
+  } // searchForward
+
+  static DOM::Node<string_type, string_adaptor> runStart(DOM::Node<string_type, string_adaptor> node)
+  {
+    if((node == 0) || !isText(node))
+      return node;
+    for(DOM::Node<string_type, string_adaptor> prev = node.getPreviousSibling(); (prev != 0) && isText(prev); prev = prev.getPreviousSibling())
+      node = prev;
+    return node;
+  } // runStart
+
+  static bool isText(const DOM::Node<string_type, string_adaptor>& node)
+  {
+    return (node.getNodeType() == DOM::Node_base::TEXT_NODE) ||
+           (node.getNodeType() == DOM::Node_base::CDATA_SECTION_NODE);
+  } // isText
+
   Axis axis_;
   NodeTest<string_type, string_adaptor>* test_;
 
@@ -199,6 +368,15 @@ private:
   std::vector<XPathExpression_impl<string_type, string_adaptor>*> predicates_;
 }; // class ExprStepExpression
 
+template<class string_type, class string_adaptor>
+class NameIndexStepExpression;
+template<class string_type, class string_adaptor>
+class AttributeIndexStepExpression;
+template<class string_type, class string_adaptor>
+class RelativeLocationPath;
+template<class string_type, class string_adaptor>
+class AbsoluteLocationPath;
+
 template<class string_type, class string_adaptor>
 class StepFactory
 {
@@ -260,7 +438,103 @@ public:
     return 0;
   } // createStep
 
+  // an absolute path starting /descendant-or-self::node()/child::name, with
+  // no predicates on either step, can be answered from the name index.  One
+  // starting //name[@attr = value] or //*[@attr = value], where the value is
+  // a literal or a variable, can be answered from the attribute value index.
+  static void useNameIndex(StepList<string_type, string_adaptor>& steps)
+  {
+    if(steps.size() < 2)
+      return;
+
+    const TestStepExpression<string_type, string_adaptor>* descendants = dynamic_cast<const TestStepExpression<string_type, string_adaptor>*>(steps[0]);
+    const TestStepExpression<string_type, string_adaptor>* children = dynamic_cast<const TestStepExpression<string_type, string_adaptor>*>(steps[1]);
+    if((descendants == 0) || (children == 0) ||
+       (descendants->axis() != DESCENDANT_OR_SELF) || (children->axis() != CHILD) ||
+       descendants->has_predicates() || 
+       (dynamic_cast<const AnyNodeTest<string_type, string_adaptor>*>(descendants->test()) == 0))
+      return;
+
+    string_type namespace_uri;
+    string_type name;
+    if(const NameNodeTest<string_type, string_adaptor>* test = dynamic_cast<const NameNodeTest<string_type, string_adaptor>*>(children->test()))
+      name = test->name();
+    else if(const QNameNodeTest<string_type, string_adaptor>* test = dynamic_cast<const QNameNodeTest<string_type, string_adaptor>*>(children->test()))
+    {
+      if(string_adaptor::empty(test->namespace_uri()))
+        return;
+      namespace_uri = test->namespace_uri();
+      name = test->name();
+    }
+    else if((dynamic_cast<const StarNodeTest<string_type, string_adaptor>*>(children->test()) == 0) ||
+            (dynamic_cast<const QStarNodeTest<string_type, string_adaptor>*>(children->test()) != 0))
+      return;
+
+    StepExpression<string_type, string_adaptor>* indexed = 0;
+    if(!children->has_predicates())
+    {
+      if(string_adaptor::empty(name))
+        return;
+      indexed = new NameIndexStepExpression<string_type, string_adaptor>(steps[0], steps[1], namespace_uri, name);
+    } 
+    else
+    {
+      string_type attribute;
+      const XPathExpression_impl<string_type, string_adaptor>* value = 0;
+      if((children->predicates().size() != 1) || 
+         !isAttributeEquality(children->predicates()[0], attribute, value))
+        return;
+      indexed = new AttributeIndexStepExpression<string_type, string_adaptor>(steps[0], steps[1], namespace_uri, name, attribute, value);
+    } // if ...
+
+    steps.pop_front();
+    steps[0] = indexed;
+  } // useNameIndex
+
 private:
+  static bool isAttributeEquality(const XPathExpression_impl<string_type, string_adaptor>* predicate,
+                                  string_type& attribute,
+                                  const XPathExpression_impl<string_type, string_adaptor>*& value)
+  {
+    const EqualsOperator<string_type, string_adaptor>* equals = dynamic_cast<const EqualsOperator<string_type, string_adaptor>*>(predicate);
+    if(equals == 0)
+      return false;
+
+    if(isAttribute(equals->lhs(), attribute) && isIndexableValue(equals->rhs()))
+      value = equals->rhs();
+    else if(isAttribute(equals->rhs(), attribute) && isIndexableValue(equals->lhs()))
+      value = equals->lhs();
+    return value != 0;
+  } // isAttributeEquality
+
+  // @name, for an attribute in no namespace
+  static bool isAttribute(const XPathExpression_impl<string_type, string_adaptor>* expr, string_type& attribute)
+  {
+    const RelativeLocationPath<string_type, string_adaptor>* path = dynamic_cast<const RelativeLocationPath<string_type, string_adaptor>*>(expr);
+    if((path == 0) || (path->steps().size() != 1) ||
+       (dynamic_cast<const AbsoluteLocationPath<string_type, string_adaptor>*>(expr) != 0))
+      return false;
+
+    const TestStepExpression<string_type, string_adaptor>* step = dynamic_cast<const TestStepExpression<string_type, string_adaptor>*>(path->steps()[0]);
+    if((step == 0) || (step->axis() != ATTRIBUTE) || step->has_predicates())
+      return false;
+
+    const AttributeNameNodeTest<string_type, string_adaptor>* test = dynamic_cast<const AttributeNameNodeTest<string_type, string_adaptor>*>(step->test());
+    if(test == 0)
+      return false;
+    attribute = test->name();
+    return true;
+  } // isAttribute
+
+  // a string literal, or a variable - its value is the same for every node
+  static bool isIndexableValue(const XPathExpression_impl<string_type, string_adaptor>* expr)
+  {
+    if(const ConstantValue<string_type, string_adaptor>* constant = dynamic_cast<const ConstantValue<string_type, string_adaptor>*>(expr))
+      return constant->type() == STRING;
+    return (dynamic_cast<const Variable<string_type, string_adaptor>*>(expr) != 0) ||
+           (dynamic_cast<const SlotVariable<string_type, string_adaptor>*>(expr) != 0);
+  } // isIndexableValue
+
   static Axis getAxis(typename types<string_adaptor>::node_iter_t& node)
   { 
     long id = getNodeId<string_adaptor>(node);
@@ -511,12 +785,174 @@ private:
   XPathExpression_impl<string_type, string_adaptor>* expr_;
 }; // class IdKeyStepExpression
 
+template<class string_type, class string_adaptor>
+const SimpleDOM::DocumentImpl<string_type, string_adaptor>* indexedDocument(const NodeSet<string_type, string_adaptor>& context)
+{
+  if((context.size() != 1) || (context[0].getNodeType() != DOM::Node_base::DOCUMENT_NODE))
+    return 0;
+  return dynamic_cast<const SimpleDOM::DocumentImpl<string_type, string_adaptor>*>(context[0].underlying_impl());
+} // indexedDocument
+
+// The long way round for the index steps - the two steps they stand in for.
+// The result is sorted, as the index's would be, so a path can stream it.
+template<class string_type, class string_adaptor>
+XPathValue<string_type, string_adaptor> walkSteps(const StepExpression<string_type, string_adaptor>* descendants,
+                                                  const StepExpression<string_type, string_adaptor>* children,
+                                                  NodeSet<string_type, string_adaptor>& context, 
+                                                  const ExecutionContext<string_type, string_adaptor>& executionContext)
+{
+  NodeSet<string_type, string_adaptor> nodes = descendants->evaluate(context, executionContext).asNodeSet();
+  nodes = children->evaluate(nodes, executionContext).asNodeSet();
+  nodes.sort();
+  return XPathValue<string_type, string_adaptor>(new NodeSetValue<string_type, string_adaptor>(nodes));
+} // walkSteps
+
+// //name and //ns:name, answered from the document's element name index when
+// the context is a SimpleDOM document, and by walking the tree otherwise
+template<class string_type, class string_adaptor>
+class NameIndexStepExpression : public StepExpression<string_type, string_adaptor>
+{
+  typedef SimpleDOM::DocumentImpl<string_type, string_adaptor> DocumentImplT;
+public:
+  NameIndexStepExpression(StepExpression<string_type, string_adaptor>* descendants,
+                          StepExpression<string_type, string_adaptor>* children,
+                          const string_type& namespace_uri,
+                          const string_type& name) :
+      descendants_(descendants),
+      children_(children),
+      namespace_uri_(namespace_uri),
+      name_(name)
+  {
+  } // NameIndexStepExpression
+
+  virtual ~NameIndexStepExpression()
+  {
+    delete descendants_;
+    delete children_;
+  } // ~NameIndexStepExpression
+
+  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
+                                                           const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    NodeSet<string_type, string_adaptor> nodes;
+    nodes.push_back(context);
+    return evaluate(nodes, executionContext);
+  } // evaluate
+
+  virtual XPathValue<string_type, string_adaptor> evaluate(NodeSet<string_type, string_adaptor>& context, const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    const DocumentImplT* document = indexedDocument<string_type, string_adaptor>(context);
+    if(document == 0)
+      return walkSteps(descendants_, children_, context, executionContext);
+
+    const typename DocumentImplT::ElementListT& elements = document->elementsByName(namespace_uri_, name_);
+    NodeSet<string_type, string_adaptor> nodes;
+    nodes.reserve(elements.size());
+    for(typename DocumentImplT::ElementListT::const_iterator e = elements.begin(), ee = elements.end(); e != ee; ++e)
+      nodes.push_back(DOM::Node<string_type, string_adaptor>(*e));
+    nodes.in_document_order();
+    return XPathValue<string_type, string_adaptor>(new NodeSetValue<string_type, string_adaptor>(nodes));
+  } // evaluate
+
+private:
+  StepExpression<string_type, string_adaptor>* descendants_;
+  StepExpression<string_type, string_adaptor>* children_;
+  string_type namespace_uri_;
+  string_type name_;
+}; // class NameIndexStepExpression
+
+// //name[@attr = value] and //*[@attr = value], answered from the document's
+// attribute value index when the context is a SimpleDOM document that has 
+// the index turned on, and the value is a string or node-set.  Otherwise the
+// tree is walked and the predicate evaluated as usual.  An empty name 
+// matches any element.
+template<class string_type, class string_adaptor>
+class AttributeIndexStepExpression : public StepExpression<string_type, string_adaptor>
+{
+  typedef SimpleDOM::DocumentImpl<string_type, string_adaptor> DocumentImplT;
+public:
+  AttributeIndexStepExpression(StepExpression<string_type, string_adaptor>* descendants,
+                               StepExpression<string_type, string_adaptor>* children,
+                               const string_type& namespace_uri,
+                               const string_type& name,
+                               const string_type& attribute,
+                               const XPathExpression_impl<string_type, string_adaptor>* value) :
+      descendants_(descendants),
+      children_(children),
+      namespace_uri_(namespace_uri),
+      name_(name),
+      attribute_(attribute),
+      value_(value)
+  {
+  } // AttributeIndexStepExpression
+
+  virtual ~AttributeIndexStepExpression()
+  {
+    delete descendants_;
+    delete children_;
+  } // ~AttributeIndexStepExpression
+
+  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, 
+                                                           const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    NodeSet<string_type, string_adaptor> nodes;
+    nodes.push_back(context);
+    return evaluate(nodes, executionContext);
+  } // evaluate
+
+  virtual XPathValue<string_type, string_adaptor> evaluate(NodeSet<string_type, string_adaptor>& context, const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    const DocumentImplT* document = indexedDocument<string_type, string_adaptor>(context);
+    if((document != 0) && document->attributeIndexing())
+    {
+      XPathValue<string_type, string_adaptor> value = value_->evaluate(context[0], executionContext);
+      if((value.type() == STRING) || (value.type() == NODE_SET))
+      {
+        NodeSet<string_type, string_adaptor> nodes;
+        if(value.type() == STRING)
+          lookup(*document, value.asString(), nodes);
+        else
+        {
+          const NodeSet<string_type, string_adaptor>& values = value.asNodeSet();
+          for(typename NodeSet<string_type, string_adaptor>::const_iterator v = values.begin(), ve = values.end(); v != ve; ++v)
+            lookup(*document, nodeStringValue<string_type, string_adaptor>(*v), nodes);
+        } // if ...
+
+        // each lookup is in document order, but several may overlap
+        if((value.type() == STRING) || (value.asNodeSet().size() < 2))
+          nodes.in_document_order();
+        else
+          nodes.sort();
+        return XPathValue<string_type, string_adaptor>(new NodeSetValue<string_type, string_adaptor>(nodes));
+      } // if ...
+    } // if ...
+
+    return walkSteps(descendants_, children_, context, executionContext);
+  } // evaluate
+
+private:
+  void lookup(const DocumentImplT& document, const string_type& value, NodeSet<string_type, string_adaptor>& nodes) const
+  {
+    const typename DocumentImplT::ElementListT& elements = document.elementsByAttribute(namespace_uri_, name_, attribute_, value);
+    for(typename DocumentImplT::ElementListT::const_iterator e = elements.begin(), ee = elements.end(); e != ee; ++e)
+      nodes.push_back(DOM::Node<string_type, string_adaptor>(*e));
+  } // lookup
+
+  StepExpression<string_type, string_adaptor>* descendants_;
+  StepExpression<string_type, string_adaptor>* children_;
+  string_type namespace_uri_;
+  string_type name_;
+  string_type attribute_;
+  const XPathExpression_impl<string_type, string_adaptor>* value_; // owned by children_'s predicate
+}; // class AttributeIndexStepExpression
+
 template<class string_type, class string_adaptor>
 class RelativeLocationPath : public XPathExpression_impl<string_type, string_adaptor>
 {
+  typedef XPathExpression_impl<string_type, string_adaptor> baseT;
 public:
-  RelativeLocationPath(StepExpression<string_type, string_adaptor>* step) : steps_() { steps_.push_back(step); }
-  RelativeLocationPath(const StepList<string_type, string_adaptor>& steps) : steps_(steps) { }
+  RelativeLocationPath(StepExpression<string_type, string_adaptor>* step) : steps_() { steps_.push_back(step); analyseStreaming(); }
+  RelativeLocationPath(const StepList<string_type, string_adaptor>& steps) : steps_(steps) { analyseStreaming(); }
 
   virtual ~RelativeLocationPath()
   {
@@ -529,7 +965,7 @@ public:
   virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, const ExecutionContext<string_type, string_adaptor>& executionContext) const
   {
     NodeSet<string_type, string_adaptor> nodes;
-    nodes.push_back(context);
+    nodes.push_back(start(context));
 
     for(typename StepList<string_type, string_adaptor>::const_iterator i = steps_.begin(); i != steps_.end(); ++i)
     {
@@ -542,8 +978,172 @@ public:
     return XPathValue<string_type, string_adaptor>(new NodeSetValue<string_type, string_adaptor>(nodes));
   } // evaluate
 
+  // Duplicates and order make no difference to whether the path selects
+  // anything, so the steps are followed one node at a time and the first
+  // node to come out of the last step is the answer.
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& context, 
+                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    FirstNode found;
+    return !followSteps(start(context), executionContext, found);
+  } // evaluateAsBool
+
+  virtual bool stream(const DOM::Node<string_type, string_adaptor>& context, 
+                      const ExecutionContext<string_type, string_adaptor>& executionContext,
+                      NodeVisitor<string_type, string_adaptor>& visitor) const
+  {
+    if((streaming_ == IN_ORDER) || ((streaming_ == DISTINCT) && !visitor.needsDocumentOrder()))
+      return followSteps(start(context), executionContext, visitor);
+    return baseT::stream(context, executionContext, visitor);
+  } // stream
+
+  const StepList<string_type, string_adaptor>& steps() const { return steps_; }
+
+protected:
+  virtual DOM::Node<string_type, string_adaptor> start(const DOM::Node<string_type, string_adaptor>& context) const 
+  { 
+    return context; 
+  } // start
+
 private:
+  // Following the steps one node at a time, rather than a step at a time,
+  // can reach a node more than once, or out of order.  SORTED paths have to
+  // be evaluated in full.  A DISTINCT path reaches each node once, and an 
+  // IN_ORDER path does that in the order the evaluated node-set would hold.
+  enum Streaming { SORTED, DISTINCT, IN_ORDER };
+
+  void analyseStreaming()
+  {
+    streaming_ = SORTED;
+    if(steps_.empty())
+    {
+      streaming_ = IN_ORDER;
+      return;
+    } // if ...
+
+    // From a single context node, a step along a forward axis is in order.
+    // The reverse axes are enumerated nearest first, back up the document.
+    const TestStepExpression<string_type, string_adaptor>* first = dynamic_cast<const TestStepExpression<string_type, string_adaptor>*>(steps_[0]);
+    bool ordered = true;
+    bool nested; // can one node reached so far be inside another?
+    if(first != 0)
+    {
+      nested = !disjointAxis(first->axis());
+      switch(first->axis())
+      {
+        case ANCESTOR:
+        case ANCESTOR_OR_SELF:
+        case PRECEDING:
+        case PRECEDING_SIBLING:
+        case NAMESPACE:
+          ordered = false;
+          break;
+        case ATTRIBUTE:
+          ordered = singleAttribute(first);
+          break;
+        default:
+          break;
+      } // switch
+    } // if ...
+    else if((dynamic_cast<const NameIndexStepExpression<string_type, string_adaptor>*>(steps_[0]) != 0) ||
+            (dynamic_cast<const AttributeIndexStepExpression<string_type, string_adaptor>*>(steps_[0]) != 0))
+      nested = true;
+    else
+      return;
+
+    // Later steps are taken from every node the one before reached.  The 
+    // nodes found are all different if the child, attribute and namespace 
+    // axes are taken from different nodes, or the descendant axes from
+    // nodes none of which is inside another.
+    for(size_t s = 1; s != steps_.size(); ++s)
+    {
+      const TestStepExpression<string_type, string_adaptor>* step = dynamic_cast<const TestStepExpression<string_type, string_adaptor>*>(steps_[s]);
+      if(step == 0)
+        return;
+      switch(step->axis())
+      {
+        case CHILD:
+          ordered = ordered && !nested;
+          break;
+        case ATTRIBUTE:
+          // a name test finds one attribute at most, but there's no order
+          // between attributes of the same element
+          ordered = ordered && singleAttribute(step);
+          nested = false;
+          break;
+        case NAMESPACE:
+          ordered = false;
+          nested = false;
+          break;
+        case SELF:
+          break;
+        case DESCENDANT:
+        case DESCENDANT_OR_SELF:
+          if(nested)
+            return;
+          nested = true;
+          break;
+        default:
+          return;
+      } // switch
+    } // for ...
+
+    streaming_ = ordered ? IN_ORDER : DISTINCT;
+  } // analyseStreaming
+
+  static bool singleAttribute(const TestStepExpression<string_type, string_adaptor>* step)
+  {
+    return (dynamic_cast<const AttributeNameNodeTest<string_type, string_adaptor>*>(step->test()) != 0) ||
+           (dynamic_cast<const AttributeQNameNodeTest<string_type, string_adaptor>*>(step->test()) != 0);
+  } // singleAttribute
+
+  static bool disjointAxis(Axis axis)
+  {
+    return (axis == CHILD) || (axis == ATTRIBUTE) || (axis == NAMESPACE) || (axis == SELF) || (axis == PARENT) ||
+           (axis == FOLLOWING_SIBLING) || (axis == PRECEDING_SIBLING);
+  } // disjointAxis
+
+  bool followSteps(const DOM::Node<string_type, string_adaptor>& context, 
+                   const ExecutionContext<string_type, string_adaptor>& executionContext,
+                   NodeVisitor<string_type, string_adaptor>& visitor) const
+  {
+    StepVisitor first(steps_.begin(), steps_.end(), executionContext, visitor);
+    return first.visit(context);
+  } // followSteps
+
+  // takes each node one step reaches through the rest of the path
+  class StepVisitor : public NodeVisitor<string_type, string_adaptor>
+  {
+    typedef typename StepList<string_type, string_adaptor>::const_iterator StepIterator;
+  public:
+    StepVisitor(StepIterator step, StepIterator end, 
+                const ExecutionContext<string_type, string_adaptor>& executionContext, 
+                NodeVisitor<string_type, string_adaptor>& visitor) :
+        step_(step), end_(end), executionContext_(executionContext), visitor_(visitor) { }
+
+    virtual bool visit(const DOM::Node<string_type, string_adaptor>& node)
+    {
+      if(step_ == end_)
+        return visitor_.visit(node);
+      StepVisitor next(step_ + 1, end_, executionContext_, visitor_);
+      return (*step_)->stream(node, executionContext_, next);
+    } // visit
+
+  private:
+    const StepIterator step_;
+    const StepIterator end_;
+    const ExecutionContext<string_type, string_adaptor>& executionContext_;
+    NodeVisitor<string_type, string_adaptor>& visitor_;
+  }; // class StepVisitor
+
+  class FirstNode : public NodeVisitor<string_type, string_adaptor>
+  {
+  public:
+    virtual bool visit(const DOM::Node<string_type, string_adaptor>& /* node */) { return false; }
+  }; // class FirstNode
+
   StepList<string_type, string_adaptor> steps_;
+  Streaming streaming_;
 
   friend class MatchExpr<string_type, string_adaptor>;
 }; // RelativeLocationPath
@@ -555,16 +1155,15 @@ public:
   AbsoluteLocationPath(StepExpression<string_type, string_adaptor>* step) : RelativeLocationPath<string_type, string_adaptor>(step) { }
   AbsoluteLocationPath(const StepList<string_type, string_adaptor>& steps) : RelativeLocationPath<string_type, string_adaptor>(steps) { }
 
-  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& context, const ExecutionContext<string_type, string_adaptor>& executionContext) const
+protected:
+  virtual DOM::Node<string_type, string_adaptor> start(const DOM::Node<string_type, string_adaptor>& context) const
   {
     int type = context.getNodeType();
     if((type == DOM::Node_base::DOCUMENT_NODE) || 
        (type == DOM::Node_base::DOCUMENT_FRAGMENT_NODE))
-      return RelativeLocationPath<string_type, string_adaptor>::evaluate(context, executionContext);
-    
-    DOM::Document<string_type, string_adaptor> document = context.getOwnerDocument();
-    return RelativeLocationPath<string_type, string_adaptor>::evaluate(document, executionContext);
-  } // evaluate
+      return context;
+    return context.getOwnerDocument();
+  } // start
 }; // class AbsoluteLocationPath
 
 } // impl
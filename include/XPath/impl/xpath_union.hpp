@@ -3,6 +3,7 @@
 
 #include "xpath_value.hpp"
 #include <algorithm>
+#include <iterator>
 
 namespace Arabica
 {
@@ -32,22 +33,68 @@ public:
     if(p2.type() != NODE_SET)
       throw RuntimeException("Union operator joins node-sets.  Second argument is not a node-set.");
 
-    NodeSet<string_type, string_adaptor> ns1(p1.asNodeSet());
-    NodeSet<string_type, string_adaptor> ns2(p2.asNodeSet());
-
     // do the obvious optimizations
-    if(ns1.empty())
-      return wrap(ns2);
-    if(ns2.empty())
-      return wrap(ns1);
+    if(p1.asNodeSet().empty())
+      return p2;
+    if(p2.asNodeSet().empty())
+      return p1;
+
+    // location paths hand back their nodes sorted, one way or the other, 
+    // so usually the two sides can just be merged 
+    const NodeSetT& lhs = p1.asNodeSet();
+    const NodeSetT& rhs = p2.asNodeSet();
+    if(lhs.forward() && rhs.forward())
+      return merge(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    if(lhs.forward() && rhs.reverse())
+      return merge(lhs.begin(), lhs.end(), rhs.rbegin(), rhs.rend());
+    if(lhs.reverse() && rhs.forward())
+      return merge(lhs.rbegin(), lhs.rend(), rhs.begin(), rhs.end());
+    if(lhs.reverse() && rhs.reverse())
+      return merge(lhs.rbegin(), lhs.rend(), rhs.rbegin(), rhs.rend());
 
-    ns1.insert(ns1.end()-1, ns2.begin(), ns2.end());
+    NodeSetT ns1(lhs);
+    ns1.insert(ns1.end()-1, rhs.begin(), rhs.end());
     ns1.to_document_order();
 
     return wrap(ns1);
   } // evaluate
 
 private:
+  typedef NodeSet<string_type, string_adaptor> NodeSetT;
+
+  // both ranges are in document order, without duplicates
+  template<class Iterator1, class Iterator2>
+  XPathValue<string_type, string_adaptor> merge(Iterator1 i1, Iterator1 e1, Iterator2 i2, Iterator2 e2) const
+  {
+    NodeSetT ns;
+    ns.reserve(std::distance(i1, e1) + std::distance(i2, e2));
+
+    if(compareNodes(*(e2-1), *i1) < 0)
+    {
+      // all of the right hand side comes first
+      ns.insert(ns.end(), i2, e2);
+      i2 = e2;
+    } // if ...
+    else if(compareNodes(*(e1-1), *i2) >= 0)
+    {
+      while((i1 != e1) && (i2 != e2))
+      {
+        int c = compareNodes(*i1, *i2);
+        if(c <= 0)
+          ns.push_back(*i1++);
+        else 
+          ns.push_back(*i2++);
+        if(c == 0)
+          ++i2;
+      } // while ...
+    } // if ...
+    ns.insert(ns.end(), i1, e1);
+    ns.insert(ns.end(), i2, e2);
+    ns.in_document_order();
+
+    return wrap(ns);
+  } // merge
+
   XPathValue<string_type, string_adaptor> wrap(const NodeSet<string_type, string_adaptor>& ns) const
   {
     return XPathValue<string_type, string_adaptor>(new NodeSetValue<string_type, string_adaptor>(ns));
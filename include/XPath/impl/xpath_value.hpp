@@ -195,6 +195,50 @@ private:
   mutable NodeSet<string_type, string_adaptor> set_;
 }; // NodeSetValue
 
+namespace impl
+{
+
+// A literal, or a subexpression folded at compile time.  Every evaluation
+// hands out the same immutable value rather than allocating a new one.
+template<class string_type, class string_adaptor>
+class ConstantValue : public XPathExpression_impl<string_type, string_adaptor>
+{
+public:
+  ConstantValue(const XPathValue<string_type, string_adaptor>& value) :
+      value_(value) { }
+
+  const XPathValue<string_type, string_adaptor>& value() const { return value_; }
+
+  virtual ValueType type() const { return value_.type(); }
+
+  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& /* context */, 
+                                                           const ExecutionContext<string_type, string_adaptor>& /* executionContext */) const
+  {
+    return value_;
+  } // evaluate
+
+  virtual bool evaluateAsBool(const DOM::Node<string_type, string_adaptor>& /* context */, 
+                              const ExecutionContext<string_type, string_adaptor>& /* executionContext */) const 
+  { 
+    return value_.asBool(); 
+  } // evaluateAsBool
+  virtual double evaluateAsNumber(const DOM::Node<string_type, string_adaptor>& /* context */, 
+                                  const ExecutionContext<string_type, string_adaptor>& /* executionContext */) const 
+  { 
+    return value_.asNumber(); 
+  } // evaluateAsNumber
+  virtual string_type evaluateAsString(const DOM::Node<string_type, string_adaptor>& /* context */, 
+                                       const ExecutionContext<string_type, string_adaptor>& /* executionContext */) const 
+  { 
+    return value_.asString(); 
+  } // evaluateAsString
+
+private:
+  const XPathValue<string_type, string_adaptor> value_;
+}; // class ConstantValue
+
+} // namespace impl
+
 } // namespace XPath
 } // namespace Arabica
 
@@ -34,6 +34,40 @@ private:
   const string_type name_;
 }; // class Variable
 
+// A variable bound to a slot when the expression was compiled.  The slot 
+// only means something to the resolver that handed it out, identified by
+// its owner number, so run against any other resolver the variable is 
+// looked up by name, as Variable does.
+template<class string_type, class string_adaptor>
+class SlotVariable : public XPathExpression_impl<string_type, string_adaptor>
+{
+public:
+  SlotVariable(unsigned long owner,
+               size_t slot,
+               const string_type& namespace_uri,
+               const string_type& name) : 
+    owner_(owner),
+    slot_(slot),
+    namespace_uri_(namespace_uri),
+    name_(name) 
+  { 
+  } // SlotVariable
+
+  virtual ValueType type() const { return ANY; }
+
+  virtual XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& /* context */, 
+                                              const ExecutionContext<string_type, string_adaptor>& executionContext) const
+  {
+    return executionContext.variableResolver().resolveSlot(owner_, slot_, namespace_uri_, name_);
+  } // evaluate
+
+private:
+  const unsigned long owner_;
+  const size_t slot_;
+  const string_type namespace_uri_;
+  const string_type name_;
+}; // class SlotVariable
+
 } // namespace XPath
 } // namespace Arabica
 
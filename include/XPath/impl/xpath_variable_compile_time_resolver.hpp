@@ -1,6 +1,10 @@
 #ifndef ARABICA_XPATH_VARIABLE_COMPILE_TIME_RESOLVER_HPP
 #define ARABICA_XPATH_VARIABLE_COMPILE_TIME_RESOLVER_HPP
 
+#include <map>
+#include <vector>
+#include <utility>
+#include <atomic>
 #include "xpath_variable.hpp"
 
 namespace Arabica
@@ -39,6 +43,104 @@ public:
   } // compileVariable
 }; // DefaultVariableCompileTimeResolver
 
+// Keeps variables in numbered slots.  Set it as both the compile time and 
+// the run time variable resolver - each $name it compiles is given a slot,
+// so evaluating the variable is an index into a vector rather than a 
+// lookup by name.  Each resolver has an owner number no other has had, 
+// copies included, so a slot is never taken to one that didn't hand it
+// out, even one that has since come to live at the same address.
+template<class string_type, class string_adaptor = Arabica::default_string_adaptor<string_type> >
+class SlotVariableResolver : public VariableResolver<string_type, string_adaptor>,
+                             public VariableCompileTimeResolver<string_type, string_adaptor>
+{
+public:
+  typedef XPathValue<string_type, string_adaptor> XPathValueT;
+
+  SlotVariableResolver() : owner_(nextOwner()) { }
+  SlotVariableResolver(const SlotVariableResolver& rhs) :
+    owner_(nextOwner()), slots_(rhs.slots_), names_(rhs.names_), values_(rhs.values_) { }
+  SlotVariableResolver& operator=(const SlotVariableResolver& rhs)
+  {
+    owner_ = nextOwner();
+    slots_ = rhs.slots_; names_ = rhs.names_; values_ = rhs.values_;
+    return *this;
+  } // operator=
+
+  size_t slotFor(const string_type& namespace_uri, const string_type& name) const
+  {
+    typename SlotMap::const_iterator s = slots_.find(std::make_pair(namespace_uri, name));
+    if(s != slots_.end())
+      return s->second;
+
+    size_t slot = names_.size();
+    slots_[std::make_pair(namespace_uri, name)] = slot;
+    names_.push_back(name);
+    values_.push_back(XPathValueT());
+    return slot;
+  } // slotFor
+
+  void setVariable(const string_type& name, const XPathValueT& value)
+  {
+    setVariable(slotFor(string_adaptor::empty_string(), name), value);
+  } // setVariable
+
+  void setVariable(const string_type& namespace_uri, const string_type& name, const XPathValueT& value)
+  {
+    setVariable(slotFor(namespace_uri, name), value);
+  } // setVariable
+
+  virtual XPathExpression_impl<string_type, string_adaptor>* compileVariable(const string_type& namespace_uri,
+                                                                             const string_type& name) const
+  {
+    return new SlotVariable<string_type, string_adaptor>(owner_, slotFor(namespace_uri, name), namespace_uri, name);
+  } // compileVariable
+
+  virtual XPathValueT resolveVariable(const string_type& namespace_uri,
+                                      const string_type& name) const
+  {
+    typename SlotMap::const_iterator s = slots_.find(std::make_pair(namespace_uri, name));
+    if(s == slots_.end())
+      throw UnboundVariableException(string_adaptor::asStdString(name));
+    return valueOf(s->second);
+  } // resolveVariable
+
+  virtual XPathValueT resolveSlot(unsigned long owner, size_t slot,
+                                  const string_type& namespace_uri,
+                                  const string_type& name) const
+  {
+    if((owner != owner_) || (slot >= values_.size()))
+      return resolveVariable(namespace_uri, name);
+    return valueOf(slot);
+  } // resolveSlot
+
+private:
+  void setVariable(size_t slot, const XPathValueT& value)
+  {
+    values_[slot] = value;
+  } // setVariable
+
+  XPathValueT valueOf(size_t slot) const
+  {
+    if(values_[slot] == 0)
+      throw UnboundVariableException(string_adaptor::asStdString(names_[slot]));
+    return values_[slot];
+  } // valueOf
+
+  static unsigned long nextOwner()
+  {
+    static std::atomic<unsigned long> owners(0);
+    return ++owners;
+  } // nextOwner
+
+
+  typedef std::map<std::pair<string_type, string_type>, size_t> SlotMap;
+  unsigned long owner_;
+  // slots are handed out as expressions are compiled, hence mutable
+  mutable SlotMap slots_;
+  mutable std::vector<string_type> names_;
+  mutable std::vector<XPathValueT> values_;
+}; // class SlotVariableResolver
+
 template<class string_type, class string_adaptor = Arabica::default_string_adaptor<string_type> >
 class NullVariableCompileTimeResolver : public VariableCompileTimeResolver<string_type, string_adaptor>
 {
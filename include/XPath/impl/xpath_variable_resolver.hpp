@@ -23,6 +23,17 @@ public:
 
   virtual XPathValue<string_type, string_adaptor> resolveVariable(const string_type& namespace_uri_,
                                                                   const string_type& name) const = 0; 
+
+  // Called for a variable given a slot when its expression was compiled -
+  // see SlotVariable and SlotVariableResolver.  The slot only means 
+  // anything to the resolver whose owner number it is, so any other 
+  // resolver looks the variable up by name.
+  virtual XPathValue<string_type, string_adaptor> resolveSlot(unsigned long /* owner */, size_t /* slot */,
+                                                              const string_type& namespace_uri,
+                                                              const string_type& name) const
+  {
+    return resolveVariable(namespace_uri, name);
+  } // resolveSlot
 }; // class VariableResolver
 
 template<class string_type, class string_adaptor>
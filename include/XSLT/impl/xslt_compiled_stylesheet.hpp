@@ -2,6 +2,7 @@
 #define ARABICA_XSLT_COMPILED_STYLESHEET_HPP
 
 #include <vector>
+#include <map>
 #include <iostream>
 #include <XPath/XPath.hpp>
 
@@ -9,6 +10,7 @@
 #include "xslt_template.hpp"
 #include "xslt_top_level_param.hpp"
 #include "xslt_key.hpp"
+#include "xslt_document_cache.hpp"
 #include "xslt_stylesheet.hpp"
 
 namespace Arabica
@@ -37,8 +39,10 @@ struct standard_stream<wchar_t>
   static std::basic_ostream<wchar_t>& err() { return std::wcerr; }
 };
 
+template<class string_type, class string_adaptor> class CompiledStylesheet;
+
 template<class string_type, class string_adaptor>
-class CompiledStylesheet : public Stylesheet<string_type, string_adaptor>
+class CompiledTransformation : public Transformation<string_type, string_adaptor>
 {
   typedef standard_stream<typename string_adaptor::value_type> streams;
 public:
@@ -46,26 +50,21 @@ public:
   typedef Arabica::XPath::NumericValue<string_type, string_adaptor> NumericValue;
   typedef Arabica::XPath::StringValue<string_type, string_adaptor> StringValue;
   typedef Arabica::XPath::XPathValue<string_type, string_adaptor> Value;
-  typedef Arabica::XPath::NodeSet<string_type, string_adaptor> NodeSet;
-  typedef DOM::Node<string_type, string_adaptor> DOMNode;
-  typedef DOM::NodeList<string_type, string_adaptor> DOMNodeList;
+  typedef std::vector<TopLevelParam<string_type, string_adaptor>*> ParamList;
+  typedef typename ParamList::const_iterator ParamListIterator;
 
-  CompiledStylesheet() :
+  CompiledTransformation(const CompiledStylesheet<string_type, string_adaptor>& stylesheet) :
+      stylesheet_(stylesheet),
       output_(new StreamSink<string_type, string_adaptor>(streams::out())),
       error_output_(&streams::err())
   {
-  } // CompiledStylesheet
+  } // CompiledTransformation
 
-  virtual ~CompiledStylesheet()
+  virtual ~CompiledTransformation()
   {
-    // let's clean up!
-    for(VariableDeclListIterator ci = topLevelVars_.begin(), ce = topLevelVars_.end(); ci != ce; ++ci)
-      delete *ci;
     for(ParamListIterator pi = params_.begin(), pe = params_.end(); pi != pe; ++pi)
       delete *pi;
-    for(TemplateListIterator ti = all_templates_.begin(), te = all_templates_.end(); ti != te; ++ti)
-      delete *ti;
-  } // ~CompiledStylesheet
+  } // ~CompiledTransformation
 
   virtual void set_parameter(const string_type& name, bool value)
   {
@@ -94,27 +93,108 @@ public:
     error_output_ = &os;
   } // set_error_output
 
-  virtual void execute(const DOMNode& initialNode) const
+  virtual void execute(const DOM::Node<string_type, string_adaptor>& initialNode) const
   {
-    if(initialNode == 0)
-      throw std::runtime_error("Input document is empty");
+    stylesheet_.execute(initialNode, params_, output_.get(), *error_output_);
+  } // execute
 
-    NodeSet ns;
-    ns.push_back(initialNode);
+private:
+  void set_parameter(const string_type& name, Value value)
+  {
+    params_.push_back(new TopLevelParam<string_type, string_adaptor>(string_adaptor::empty_string(), name, value));
+  } // set_parameter
 
-    ExecutionContext<string_type, string_adaptor> context(*this, output_.get(), *error_output_);
+  void set_parameter(const string_type& namespace_uri, const string_type& name, Value value)
+  {
+    params_.push_back(new TopLevelParam<string_type, string_adaptor>(namespace_uri, name, value));
+  } // set_parameter
 
-    // set up variables and so forth
-    for(ParamListIterator pi = params_.begin(), pe = params_.end(); pi != pe; ++pi)
-      (*pi)->declare(context);
+  const CompiledStylesheet<string_type, string_adaptor>& stylesheet_;
+  ParamList params_;
+  SinkHolder<string_type, string_adaptor> output_;
+  std::basic_ostream<typename string_adaptor::value_type>* error_output_;
+
+  CompiledTransformation(const CompiledTransformation&);
+  CompiledTransformation& operator=(const CompiledTransformation&);
+  bool operator==(const CompiledTransformation&) const;
+}; // class CompiledTransformation
+
+template<class string_type, class string_adaptor>
+class CompiledStylesheet : public Stylesheet<string_type, string_adaptor>
+{
+public:
+  typedef Arabica::XPath::BoolValue<string_type, string_adaptor> BoolValue;
+  typedef Arabica::XPath::NumericValue<string_type, string_adaptor> NumericValue;
+  typedef Arabica::XPath::StringValue<string_type, string_adaptor> StringValue;
+  typedef Arabica::XPath::XPathValue<string_type, string_adaptor> Value;
+  typedef Arabica::XPath::NodeSet<string_type, string_adaptor> NodeSet;
+  typedef DOM::Node<string_type, string_adaptor> DOMNode;
+  typedef DOM::NodeList<string_type, string_adaptor> DOMNodeList;
+
+  CompiledStylesheet() :
+      defaults_(*this)
+  {
+  } // CompiledStylesheet
+
+  virtual ~CompiledStylesheet()
+  {
+    // let's clean up!
     for(VariableDeclListIterator ci = topLevelVars_.begin(), ce = topLevelVars_.end(); ci != ce; ++ci)
-      (*ci)->execute(initialNode, context);
-    context.freezeTopLevel();
+      delete *ci;
+    for(TemplateListIterator ti = all_templates_.begin(), te = all_templates_.end(); ti != te; ++ti)
+      delete *ti;
+  } // ~CompiledStylesheet
 
-    // go!
-    output_.get().asOutput().start_document(output_settings_, output_cdata_elements_);
-    applyTemplates(ns, context, string_adaptor::empty_string());
-    output_.get().asOutput().end_document();
+  virtual std::auto_ptr<Transformation<string_type, string_adaptor> > create_transformation() const
+  {
+    return std::auto_ptr<Transformation<string_type, string_adaptor> >(new CompiledTransformation<string_type, string_adaptor>(*this));
+  } // create_transformation
+
+  virtual void set_key_index_limit(size_t documents)
+  {
+    keys_.limit(documents);
+  } // set_key_index_limit
+
+  virtual void release_key_indexes(const DOMNode& document) const
+  {
+    keys_.release(document);
+  } // release_key_indexes
+
+  virtual void set_shared_document_limit(size_t documents) const
+  {
+    DocumentCache<string_type, string_adaptor>::share(documents);
+  } // set_shared_document_limit
+
+  virtual void set_parameter(const string_type& name, bool value)
+  {
+    defaults_.set_parameter(name, value);
+  } // set_parameter
+  virtual void set_parameter(const string_type& name, double value)
+  {
+    defaults_.set_parameter(name, value);
+  } // set_parameter
+  virtual void set_parameter(const string_type& name, const char* value)
+  {
+    defaults_.set_parameter(name, value);
+  } // set_parameter
+  virtual void set_parameter(const string_type& name, const string_type& value)
+  {
+    defaults_.set_parameter(name, value);
+  } // set_parameter
+
+  virtual void set_output(Sink<string_type, string_adaptor>& sink)
+  {
+    defaults_.set_output(sink);
+  } // set_output
+
+  virtual void set_error_output(std::basic_ostream<typename string_adaptor::value_type>& os)
+  {
+    defaults_.set_error_output(os);
+  } // set_error_output
+
+  virtual void execute(const DOMNode& initialNode) const
+  {
+    defaults_.execute(initialNode);
   } // execute
 
   ////////////////////////////////////////
@@ -177,6 +257,12 @@ public:
         std::reverse(matches.begin(), matches.end());
         std::stable_sort(matches.begin(), matches.end());
       } // for ...
+
+    // highest import precedence first, then in priority order
+    for(typename TemplateStack::reverse_iterator ts = templates_.rbegin(), tse = templates_.rend(); ts != tse; ++ts)
+      for(ModeTemplatesIterator ms = ts->second.begin(), mse = ts->second.end(); ms != mse; ++ms)
+        for(MatchTemplatesIterator m = ms->second.begin(), me = ms->second.end(); m != me; ++m)
+          template_index_[ms->first].add(m->match(), &*m);
   } // prepare
 
   ////////////////////////////////////////
@@ -228,10 +314,41 @@ public:
 
   void applyImports(const DOMNode& node, ExecutionContext<string_type, string_adaptor>& context) const
   {
-    doApplyTemplates(node, context, current_mode_, current_generation_);
+    doApplyTemplates(node, context, context.mode(), context.generation());
   } // applyImports
 
 private:
+  typedef typename CompiledTransformation<string_type, string_adaptor>::ParamList ParamList;
+  typedef typename CompiledTransformation<string_type, string_adaptor>::ParamListIterator ParamListIterator;
+
+  // everything a run changes lives in the execution context, not here
+  void execute(const DOMNode& initialNode, 
+               const ParamList& params,
+               Sink<string_type, string_adaptor>& output,
+               std::basic_ostream<typename string_adaptor::value_type>& error_output) const
+  {
+    if(initialNode == 0)
+      throw std::runtime_error("Input document is empty");
+
+    NodeSet ns;
+    ns.push_back(initialNode);
+
+    ExecutionContext<string_type, string_adaptor> context(*this, output, error_output);
+    typename DocumentCache<string_type, string_adaptor>::Transformation documents;
+
+    // set up variables and so forth
+    for(ParamListIterator pi = params.begin(), pe = params.end(); pi != pe; ++pi)
+      (*pi)->declare(context);
+    for(VariableDeclListIterator ci = topLevelVars_.begin(), ce = topLevelVars_.end(); ci != ce; ++ci)
+      (*ci)->execute(initialNode, context);
+    context.freezeTopLevel();
+
+    // go!
+    output.asOutput().start_document(output_settings_, output_cdata_elements_);
+    applyTemplates(ns, context, string_adaptor::empty_string());
+    output.asOutput().end_document();
+  } // execute
+
   void doApplyTemplates(const DOMNode& node, 
                         ExecutionContext<string_type, string_adaptor>& context, 
                         const string_type& mode, 
@@ -239,30 +356,25 @@ private:
   {
     StackFrame<string_type, string_adaptor> frame(context);
 
-    std::vector<Precedence> lower_precedences;
-    for(TemplateStackIterator ts = templates_.begin(), tse = templates_.end(); ts != tse; ++ts)
-      if(generation.is_descendant(ts->first))
-        lower_precedences.push_back(ts->first);
-    std::sort(lower_precedences.rbegin(), lower_precedences.rend());
+    context.setMode(mode);
 
-    current_mode_ = mode;
-
-    for(std::vector<Precedence>::const_iterator p = lower_precedences.begin(), pe = lower_precedences.end(); p != pe; ++p)
-    { 
-      current_generation_ = *p;
-      ModeTemplates ts = templates_.find(current_generation_)->second;
-      ModeTemplatesIterator mt = ts.find(mode);
-      if(mt != ts.end())
+    TemplateIndexIterator index = template_index_.find(mode);
+    if(index != template_index_.end())
+    {
+      const Candidates& candidates = index->second.candidates(node);
+      for(CandidatesIterator t = candidates.begin(), te = candidates.end(); t != te; ++t)
       {
-        const MatchTemplates& templates = mt->second;
-	      for(MatchTemplatesIterator t = templates.begin(), te = templates.end(); t != te; ++t)
-	        if(t->match().evaluate(node, context.xpathContext()))
-	        {
-	          t->action()->execute(node, context);
-	          return;
-	        } // if ...
-      } // if ...
-    } // for ...
+        const Precedence& precedence = (*t)->action()->precedence();
+        if(!generation.is_descendant(precedence))
+          continue;
+        if((*t)->match().evaluate(node, context.xpathContext()))
+        {
+          context.setGeneration(precedence);
+          (*t)->action()->execute(node, context);
+          return;
+        } // if ...
+      } // for ...
+    } // if ...
     defaultAction(node, context, mode);
   } // doApplyTemplates
 
@@ -298,16 +410,6 @@ private:
     } // switch
   } // defaultAction
 
-  void set_parameter(const string_type& name, Value value)
-  {
-    params_.push_back(new TopLevelParam<string_type, string_adaptor>(string_adaptor::empty_string(), name, value));
-  } // set_parameter
-
-  void set_parameter(const string_type& namespace_uri, const string_type& name, Value value)
-  {
-    params_.push_back(new TopLevelParam<string_type, string_adaptor>(namespace_uri, name, value));
-  } // set_parameter
-
 private:
   class MatchTemplate
   {
@@ -336,6 +438,14 @@ private:
     Template<string_type, string_adaptor>* template_;
   }; // struct MatchTemplate
 
+  // One mode's templates, filed by the type and name of node their patterns
+  // can match.  Every list is in the order the templates are tried, so the 
+  // first match in a node's list is the same template a search through all
+  // of them would have found.
+  typedef Arabica::XPath::MatchIndex<const MatchTemplate*, string_type, string_adaptor> TemplateIndex;
+  typedef typename TemplateIndex::Candidates Candidates;
+  typedef typename Candidates::const_iterator CandidatesIterator;
+
   typedef std::vector<Template<string_type, string_adaptor>*> TemplateList;
   typedef typename TemplateList::const_iterator TemplateListIterator;
   typedef std::vector<MatchTemplate> MatchTemplates;
@@ -344,28 +454,26 @@ private:
   typedef typename ModeTemplates::const_iterator ModeTemplatesIterator;
   typedef std::map<Precedence, ModeTemplates> TemplateStack;
   typedef typename TemplateStack::const_iterator TemplateStackIterator;
+  typedef std::map<string_type, TemplateIndex> TemplateIndexes;
+  typedef typename TemplateIndexes::const_iterator TemplateIndexIterator;
   typedef std::map<string_type, Template<string_type, string_adaptor>*> NamedTemplates;
   typedef typename NamedTemplates::const_iterator NamedTemplatesIterator;
   
   typedef std::vector<Item<string_type, string_adaptor>*> VariableDeclList;
   typedef typename std::vector<Item<string_type, string_adaptor>*>::const_iterator VariableDeclListIterator;
-  typedef std::vector<TopLevelParam<string_type, string_adaptor>*> ParamList;
-  typedef typename ParamList::const_iterator ParamListIterator;
 
   TemplateList all_templates_;
   NamedTemplates named_templates_;
   TemplateStack templates_;
+  TemplateIndexes template_index_;
   VariableDeclList topLevelVars_;
   DeclaredKeys<string_type, string_adaptor> keys_;
-  ParamList params_;
-
-  mutable string_type current_mode_;
-  mutable Precedence current_generation_;
 
   typename Output<string_type, string_adaptor>::Settings output_settings_;
   typename Output<string_type, string_adaptor>::CDATAElements output_cdata_elements_;
-  SinkHolder<string_type, string_adaptor> output_;
-  mutable std::basic_ostream<typename string_adaptor::value_type>* error_output_;
+  CompiledTransformation<string_type, string_adaptor> defaults_;
+
+  friend class CompiledTransformation<string_type, string_adaptor>;
 }; // class CompiledStylesheet
 
 } // namespace XSLT
@@ -0,0 +1,163 @@
+#ifndef ARABICA_XSLT_DOCUMENT_CACHE_HPP
+#define ARABICA_XSLT_DOCUMENT_CACHE_HPP
+
+#include <list>
+#include <map>
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <io/uri.hpp>
+
+namespace Arabica
+{
+namespace XSLT
+{
+
+// The documents document() has loaded.  Within a transformation, every
+// call with the same absolute URI gets the same document, parsed once.
+// Documents loaded from files can also be kept from one transformation to
+// the next - see share - and are parsed again only once their file has
+// changed.  Both are kept per thread.  A document's nodes are reference
+// counted without any locking, so a document has to stay on the thread
+// that loaded it.
+template<class string_type, class string_adaptor>
+class DocumentCache
+{
+public:
+  typedef DOM::Node<string_type, string_adaptor> DOMNode;
+
+  // Holds the documents loaded while a transformation runs, for as long
+  // as it runs
+  class Transformation
+  {
+  public:
+    Transformation() : previous_(current()) { current() = this; }
+    ~Transformation() { current() = previous_; }
+
+  private:
+    std::map<std::string, DOMNode> documents_;
+    Transformation* previous_;
+
+    friend class DocumentCache;
+    Transformation(const Transformation&);
+    Transformation& operator=(const Transformation&);
+  }; // class Transformation
+
+  // Keep up to this many documents for the transformations this thread
+  // runs later.  The default, 0, keeps none.
+  static void share(size_t documents)
+  {
+    Shared& s = shared();
+    s.limit = documents;
+    while(s.documents.size() > s.limit)
+      s.documents.pop_back();
+  } // share
+
+  static DOMNode find(const std::string& uri)
+  {
+    Transformation* transformation = current();
+    if(transformation != 0)
+    {
+      typename std::map<std::string, DOMNode>::const_iterator d = transformation->documents_.find(uri);
+      if(d != transformation->documents_.end())
+        return d->second;
+    } // if ...
+
+    Shared& s = shared();
+    for(typename SharedList::iterator d = s.documents.begin(), de = s.documents.end(); d != de; ++d)
+      if(d->uri == uri)
+      {
+        FileStamp stamp;
+        if(!stampOf(uri, stamp) || !(stamp == d->stamp))
+        {
+          s.documents.erase(d);
+          break;
+        } // if ...
+        s.documents.splice(s.documents.begin(), s.documents, d);
+        if(transformation != 0)
+          transformation->documents_[uri] = d->document;
+        return d->document;
+      } // if ...
+
+    return DOMNode();
+  } // find
+
+  static void add(const std::string& uri, const DOMNode& document)
+  {
+    Transformation* transformation = current();
+    if(transformation != 0)
+      transformation->documents_[uri] = document;
+
+    Shared& s = shared();
+    FileStamp stamp;
+    if(s.limit == 0 || !stampOf(uri, stamp))
+      return;
+    s.documents.push_front(SharedDocument(uri, document, stamp));
+    while(s.documents.size() > s.limit)
+      s.documents.pop_back();
+  } // add
+
+private:
+  struct FileStamp
+  {
+    FileStamp() : modified(0), size(0) { }
+    bool operator==(const FileStamp& rhs) const { return modified == rhs.modified && size == rhs.size; }
+
+    time_t modified;
+    off_t size;
+  }; // struct FileStamp
+
+  struct SharedDocument
+  {
+    SharedDocument(const std::string& u, const DOMNode& d, const FileStamp& s) : uri(u), document(d), stamp(s) { }
+
+    std::string uri;
+    DOMNode document;
+    FileStamp stamp;
+  }; // struct SharedDocument
+  typedef std::list<SharedDocument> SharedList;
+
+  struct Shared
+  {
+    Shared() : limit(0) { }
+
+    size_t limit;
+    SharedList documents; // most recently used first
+  }; // struct Shared
+
+  // only documents loaded from files can be checked for changes
+  static bool stampOf(const std::string& uri, FileStamp& stamp)
+  {
+    Arabica::io::URI url(uri);
+    if(!url.scheme().empty() && url.scheme() != "file")
+      return false;
+
+    std::string fileName = url.path();
+    if((fileName.length() > 2) && (fileName[0] == '/') && (fileName[2] == ':'))
+      fileName.erase(0, 1);
+
+    struct stat status;
+    if(stat(fileName.c_str(), &status) != 0)
+      return false;
+    stamp.modified = status.st_mtime;
+    stamp.size = status.st_size;
+    return true;
+  } // stampOf
+
+  static Transformation*& current()
+  {
+    static thread_local Transformation* transformation = 0;
+    return transformation;
+  } // current
+
+  static Shared& shared()
+  {
+    static thread_local Shared s;
+    return s;
+  } // shared
+}; // class DocumentCache
+
+} // namespace XSLT
+} // namespace Arabica
+
+#endif
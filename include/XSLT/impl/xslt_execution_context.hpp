@@ -57,7 +57,9 @@ public:
     stack_(rhs.stack_),
     sink_(output.asOutput()),
     message_sink_(rhs.message_sink_),
-    to_msg_(false)
+    to_msg_(false),
+    mode_(rhs.mode_),
+    generation_(rhs.generation_)
   {
 		xpathContext_.setVariableResolver(stack_);
     xpathContext_.setCurrentNode(rhs.xpathContext().currentNode());
@@ -76,6 +78,13 @@ public:
 
   const Arabica::XPath::ExecutionContext<string_type, string_adaptor>& xpathContext() const { return xpathContext_; }
 
+  // the mode and import precedence of the last template rule chosen, 
+  // which is where xsl:apply-imports picks up from
+  const string_type& mode() const { return mode_; }
+  const Precedence& generation() const { return generation_; }
+  void setMode(const string_type& mode) { mode_ = mode; }
+  void setGeneration(const Precedence& generation) { generation_ = generation; }
+
   void topLevelParam(const DOM::Node<string_type, string_adaptor>& node, const Variable_declaration<string_type, string_adaptor>& param);
   string_type passParam(const DOM::Node<string_type, string_adaptor>& node, const Variable_declaration<string_type, string_adaptor>& param);
   void unpassParam(const string_type& name);
@@ -110,6 +119,8 @@ private:
   Output<string_type, string_adaptor>& sink_;
   StreamSink<string_type, string_adaptor> message_sink_;
   int to_msg_;
+  string_type mode_;
+  Precedence generation_;
 
   friend class StackFrame<string_type, string_adaptor> ;
   friend class ChainStackFrame<string_type, string_adaptor> ;
@@ -3,6 +3,7 @@
 
 #include <DOM/SAX2DOM/SAX2DOM.hpp>
 #include <SAX/helpers/CatchErrorHandler.hpp>
+#include "xslt_document_cache.hpp"
 
 namespace Arabica
 {
@@ -54,26 +55,74 @@ protected:
   } // doEvaluate
 
 private:
+  typedef DocumentCache<string_type, string_adaptor> Cache;
+
   void load_document(const string_type& location, NodeSet& nodes) const
   {
-    SAX2DOM::Parser<string_type, string_adaptor> domParser;
-    SAX::CatchErrorHandler<string_type, string_adaptor> eh;
-    domParser.setErrorHandler(eh);
-
     Arabica::io::URI base(string_adaptor::asStdString(baseURI_));
     Arabica::io::URI absolute(base, string_adaptor::asStdString(location));
-    SAX::InputSource<string_type, string_adaptor> is(string_adaptor::construct_from_utf8(absolute.as_string().c_str()));
-    domParser.parse(is);
+    const std::string uri = absolute.as_string();
 
-    if(!eh.errorsReported())
-      nodes.push_back(domParser.getDocument());
-    else
-      std::cerr << eh.errors() << std::endl;
+    DOMNode document = Cache::find(uri);
+    if(document == 0)
+    {
+      SAX2DOM::Parser<string_type, string_adaptor> domParser;
+      SAX::CatchErrorHandler<string_type, string_adaptor> eh;
+      domParser.setErrorHandler(eh);
+
+      SAX::InputSource<string_type, string_adaptor> is(string_adaptor::construct_from_utf8(uri.c_str()));
+      domParser.parse(is);
+
+      if(eh.errorsReported())
+      {
+        std::cerr << eh.errors() << std::endl;
+        return;
+      } // if ...
+      document = domParser.getDocument();
+      Cache::add(uri, document);
+    } // if ...
+
+    nodes.push_back(document);
   } // load_document
 
   string_type baseURI_; 
 }; // DocumentFunction
 
+// The result of key() - the nodes are shared with the key's index rather 
+// than copied out of it.  They are always in document order.
+template<class string_type, class string_adaptor>
+class KeyNodeSetValue : public Arabica::XPath::Value_base<string_type, string_adaptor>
+{
+public:
+  typedef typename DeclaredKeys<string_type, string_adaptor>::NodeSetPtr NodeSetPtr;
+
+  KeyNodeSetValue(const NodeSetPtr& nodes) : nodes_(nodes) { }
+
+  virtual Arabica::XPath::XPathValue<string_type, string_adaptor> evaluate(const DOM::Node<string_type, string_adaptor>& /* context */, 
+                                                                           const Arabica::XPath::ExecutionContext<string_type, string_adaptor>& /* executionContext */) const
+  {
+    return Arabica::XPath::XPathValue<string_type, string_adaptor>(new KeyNodeSetValue(nodes_));
+  } // evaluate
+
+  virtual bool asBool() const { return !nodes_->empty(); }
+  virtual double asNumber() const 
+  { 
+    return Arabica::XPath::impl::stringAsNumber<string_type, string_adaptor>(asString());
+  } // asNumber
+  virtual string_type asString() const 
+  { 
+    if(nodes_->empty())
+      return string_adaptor::empty_string();
+    return Arabica::XPath::impl::nodeStringValue<string_type, string_adaptor>((*nodes_)[0]);
+  } // asString
+  virtual const Arabica::XPath::NodeSet<string_type, string_adaptor>& asNodeSet() const { return *nodes_; }
+
+  virtual Arabica::XPath::ValueType type() const { return Arabica::XPath::NODE_SET; }
+
+private:
+  NodeSetPtr nodes_;
+}; // class KeyNodeSetValue
+
 // node-set key(string, object)
 template<class string_type, class string_adaptor>
 class KeyFunction : public Arabica::XPath::NodeSetXPathFunction<string_type, string_adaptor>
@@ -84,6 +133,7 @@ class KeyFunction : public Arabica::XPath::NodeSetXPathFunction<string_type, str
   typedef std::vector<XPathExpression> ArgList;
   typedef Arabica::XPath::XPathValue<string_type, string_adaptor> XPathValue;
   typedef Arabica::XPath::NodeSet<string_type, string_adaptor> NodeSet;
+  typedef typename DeclaredKeys<string_type, string_adaptor>::NodeSetPtr NodeSetPtr;
   typedef Arabica::XPath::ExecutionContext<string_type, string_adaptor> XPathExecutionContext;
   typedef DOM::Node<string_type, string_adaptor> DOMNode;
   typedef XML::QualifiedName<string_type, string_adaptor> QualifiedName;
@@ -103,19 +153,37 @@ public:
   { 
   } // KeyFunction
 
+  virtual Arabica::XPath::XPathValue_impl<string_type, string_adaptor>* evaluate(const DOMNode& context,
+                                                                                const XPathExecutionContext& executionContext) const
+  {
+    return new KeyNodeSetValue<string_type, string_adaptor>(keyNodes(context, executionContext));
+  } // evaluate
+
+  virtual bool evaluateAsBool(const DOMNode& context,
+                              const XPathExecutionContext& executionContext) const
+  {
+    return !keyNodes(context, executionContext)->empty();
+  } // evaluateAsBool
+
 protected:
   virtual NodeSet doEvaluate(const DOMNode& context,
                              const XPathExecutionContext& executionContext) const
+  {
+    return *keyNodes(context, executionContext);
+  } // doEvaluate
+
+  NodeSetPtr keyNodes(const DOMNode& context,
+                      const XPathExecutionContext& executionContext) const
   {
     string_type keyname      = this->argAsString(0, context, executionContext);
     string_type keyClarkName = QualifiedName::parseQName(keyname, true, namespaces_).clarkName();
 
     XPathValue a1 = baseT::arg(1, context, executionContext);
     if(a1.type() == Arabica::XPath::NODE_SET)
-      return nodeSetUnion(keyClarkName, a1.asNodeSet(), executionContext);
+      return NodeSetPtr(new NodeSet(nodeSetUnion(keyClarkName, a1.asNodeSet(), executionContext)));
 
     return keys_.lookup(keyClarkName, a1.asString(), executionContext);
-  } // doEvaluate
+  } // keyNodes
 
   NodeSet nodeSetUnion(const string_type& keyClarkName, 
                        const NodeSet nodes,
@@ -125,7 +193,7 @@ protected:
     for(typename NodeSet::const_iterator n = nodes.begin(), ne = nodes.end(); n != ne; ++n)
     {
       string_type id = Arabica::XPath::impl::nodeStringValue<string_type, string_adaptor>(*n);
-      results.push_back(keys_.lookup(keyClarkName, id, executionContext));
+      results.push_back(*keys_.lookup(keyClarkName, id, executionContext));
     } // for ...
     results.to_document_order();
     return results;
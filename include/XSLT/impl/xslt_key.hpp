@@ -1,6 +1,13 @@
 #ifndef ARABICA_XSLT_KEY_HPP
 #define ARABICA_XSLT_KEY_HPP
 
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <boost/shared_ptr.hpp>
 #include "xslt_execution_context.hpp"
 
 namespace Arabica
@@ -17,6 +24,7 @@ public:
   typedef Arabica::XPath::XPathExpression<string_type, string_adaptor> XPathExpression;
   typedef DOM::Node<string_type, string_adaptor> DOMNode;
   typedef Arabica::XPath::ExecutionContext<string_type, string_adaptor> XPathContext;
+  typedef std::unordered_map<string_type, NodeSet, XPath::impl::hashStringValue<string_type, string_adaptor> > NodeMap;
 
   Key(MatchExprList& matches,
       XPathExpression& use) :
@@ -25,103 +33,267 @@ public:
   {
   } // Key
 
-  NodeSet lookup(const string_type& value, const XPathContext& context) const
-  {
-    DOMNode doc = XPath::impl::get_owner_document(context.currentNode());
-    DocumentNodeMapIterator nm = nodesPerDocument_.find(doc.underlying_impl());
-    if(nm == nodesPerDocument_.end())
-      populate(nodesPerDocument_[doc.underlying_impl()], context);
+  const MatchExprList& matches() const { return matches_; }
 
-    const NodeMap& nodes = nodesPerDocument_[doc.underlying_impl()];
-    NodeMapIterator f = nodes.find(value);
-    if(f == nodes.end())
-      return NodeSet(0);
+  bool matches(const DOMNode& node, const XPathContext& context) const
+  {
+    for(MatchExprListIterator me = matches_.begin(), mee = matches_.end(); me != mee; ++me)
+      if(me->evaluate(node, context))
+        return true;
+    return false;
+  } // matches
 
-    return f->second;
-  } // lookup
+  // files a node the key matches under each of its use values
+  void index(NodeMap& nodes, const DOMNode& node, const XPathContext& context) const
+  {
+    NodeSet ids = use_.evaluateAsNodeSet(node, context);
+    for(NodeSetIterator i = ids.begin(), ie = ids.end(); i != ie; ++i)
+    {
+      string_type id = Arabica::XPath::impl::nodeStringValue<string_type, string_adaptor>(*i);
+      NodeSet& indexed = nodes[id];
+      // nodes arrive in document order, so any duplicate is the last one in
+      if(indexed.empty() || indexed[indexed.size()-1] != node)
+        indexed.push_back(node);
+    } // for ...
+  } // index
 
 private:
-  typedef std::map<string_type, NodeSet> NodeMap;
-  typedef typename NodeMap::const_iterator NodeMapIterator;
-  typedef std::map<DOM::Node_impl<string_type, string_adaptor>*, NodeMap> DocumentNodeMap;
-  typedef typename DocumentNodeMap::const_iterator DocumentNodeMapIterator;
   typedef typename NodeSet::iterator NodeSetIterator;
   typedef typename MatchExprList::const_iterator MatchExprListIterator;
- 
-  void populate(NodeMap& nodes, const XPathContext& context) const
-  {
-    typedef XPath::AxisEnumerator<string_type, string_adaptor> AxisEnum;
-
-    DOMNode current = XPath::impl::get_owner_document(context.currentNode());
-
-    for(AxisEnum ae(current, XPath::DESCENDANT_OR_SELF); *ae != 0; ++ae)
-    {
-      DOMNode node = *ae;
-      for(MatchExprListIterator me = matches_.begin(), mee = matches_.end(); me != mee; ++me)
-        if(me->evaluate(node, context))
-        {
-	        NodeSet ids = use_.evaluateAsNodeSet(node, context);
-	        for(NodeSetIterator i = ids.begin(), ie = ids.end(); i != ie; ++i)
-	        {
-	          string_type id = Arabica::XPath::impl::nodeStringValue<string_type, string_adaptor>(*i);
-	          nodes[id].push_back(node);
-	        } // for ...
-          break;
-        } // if ...
-    } // for 
-  } // populate
 
   MatchExprList matches_;
   XPathExpression use_;
-  mutable DocumentNodeMap nodesPerDocument_;
-
 }; // class Key
 
+// The first time any key is used on a document, every declared key is
+// indexed for it in one walk over the document, each node only tried 
+// against the match patterns that could apply to its type and name.  The
+// indexes of the documents used most recently are kept.  They hold on to 
+// their document, so the document can't go away and have its address
+// reused while its indexes are still around.
+//
+// Each thread keeps the indexes of the documents it has used to itself.
+// A document's nodes are reference counted without any locking, so only 
+// the thread using the document can safely build or drop its indexes.
 template<class string_type, class string_adaptor>
 class DeclaredKeys
 {
 public:
+  typedef Key<string_type, string_adaptor> KeyType;
   typedef Arabica::XPath::NodeSet<string_type, string_adaptor> NodeSet;
+  typedef boost::shared_ptr<const NodeSet> NodeSetPtr;
   typedef Arabica::XPath::ExecutionContext<string_type, string_adaptor> XPathContext;
+  typedef DOM::Node<string_type, string_adaptor> DOMNode;
 
-  DeclaredKeys() { }
+  DeclaredKeys() : limit_(DefaultLimit) { }
   ~DeclaredKeys() 
   { 
-    for(KeysIterator i = keys_.begin(), ie = keys_.end(); i != ie; ++i)
-      for(KeyListIterator k = i->second.begin(), ke = i->second.end(); k != ke; ++k)
-  	    delete (*k);
+    for(KeyListIterator k = all_.begin(), ke = all_.end(); k != ke; ++k)
+      delete (*k);
   } // ~DeclaredKeys
 
-  void add(const string_type& name, Key<string_type, string_adaptor>* key)
+  void add(const string_type& name, KeyType* key)
   {
-    keys_[name].push_back(key);
+    const size_t number = all_.size();
+    all_.push_back(key);
+    keys_[name].push_back(number);
+
+    const typename KeyType::MatchExprList& matches = key->matches();
+    for(typename KeyType::MatchExprList::const_iterator m = matches.begin(), me = matches.end(); m != me; ++m)
+      patterns_.add(*m, Pattern(number, &*m));
   } // add_key
 
-  NodeSet lookup(const string_type& name,
-	               const string_type& id,
-                 const XPathContext& context) const
+  // The nodes are shared with the index, in document order, and stay good
+  // after the index itself has been released
+  NodeSetPtr lookup(const string_type& name,
+	                  const string_type& id,
+                    const XPathContext& context) const
   {
     const KeysIterator k = keys_.find(name);
     if(k == keys_.end())
       throw SAX::SAXException("No key named '" + string_adaptor::asStdString(name) + "' has been defined.");
-    
+
+    const DOMNode document = XPath::impl::get_owner_document(context.currentNode());
     if(k->second.size() == 1)
-      return k->second[0]->lookup(id, context);
+      return lookup(k->second[0], document, id, context);
     
-    NodeSet nodes;
-    for(KeyListIterator key = k->second.begin(), keye = k->second.end(); key != keye; ++key)    
-      nodes.push_back((*key)->lookup(id, context));
-    nodes.to_document_order();
+    boost::shared_ptr<NodeSet> nodes(new NodeSet);
+    for(NumberListIterator key = k->second.begin(), keye = k->second.end(); key != keye; ++key)    
+      nodes->push_back(*lookup(*key, document, id, context));
+    nodes->to_document_order();
     return nodes;
   } // lookup
 
+  // drops the indexes the calling thread has for the document
+  void release(const DOMNode& document) const
+  {
+    Documents& documents = threadDocuments();
+    for(typename Documents::iterator i = documents.begin(), ie = documents.end(); i != ie; ++i)
+      if((*i)->document == document)
+      {
+        documents.erase(i);
+        return;
+      } // if ...
+  } // release
+
+  // other threads come down to the new limit the next time they index a
+  // document
+  void limit(size_t documents)
+  {
+    limit_ = documents;
+    evict(threadDocuments());
+  } // limit
+
+  static const size_t DefaultLimit = 8;
+
 private:
-  typedef std::vector<Key<string_type, string_adaptor>*> KeyList;
-  typedef typename std::vector<Key<string_type, string_adaptor>*>::const_iterator KeyListIterator;
-  typedef std::map<string_type, KeyList> Keys;
+  typedef typename KeyType::NodeMap NodeMap;
+  typedef typename NodeMap::const_iterator NodeMapIterator;
+  struct Index
+  {
+    NodeMap nodes;
+    NodeSet none;
+  }; // struct Index
+  typedef boost::shared_ptr<Index> IndexPtr;
+  typedef std::vector<IndexPtr> IndexList;
+  // every key's index for one document
+  struct DocumentIndexes
+  {
+    DocumentIndexes(const DOMNode& d, size_t keys) : document(d), built(keys), building(keys) { }
+
+    DOMNode document;
+    IndexList built;
+    IndexList building; // keys being indexed on their own - see indexFor
+  }; // struct DocumentIndexes
+  typedef boost::shared_ptr<DocumentIndexes> DocumentIndexesPtr;
+  typedef std::list<DocumentIndexesPtr> Documents;
+  typedef std::map<std::thread::id, Documents> ThreadDocuments;
+
+  typedef std::pair<size_t, const Arabica::XPath::MatchExpr<string_type, string_adaptor>*> Pattern;
+  typedef Arabica::XPath::MatchIndex<Pattern, string_type, string_adaptor> Patterns;
+  typedef typename Patterns::Candidates::const_iterator PatternIterator;
+
+  typedef std::vector<KeyType*> KeyList;
+  typedef typename KeyList::const_iterator KeyListIterator;
+  typedef std::vector<size_t> NumberList;
+  typedef typename NumberList::const_iterator NumberListIterator;
+  typedef std::map<string_type, NumberList> Keys;
   typedef typename Keys::const_iterator KeysIterator;
 
+  NodeSetPtr lookup(size_t key, const DOMNode& document, const string_type& id, const XPathContext& context) const
+  {
+    IndexPtr index = indexFor(key, document, context);
+
+    NodeMapIterator f = index->nodes.find(id);
+    if(f == index->nodes.end())
+      return NodeSetPtr(index, &index->none);
+
+    return NodeSetPtr(index, &f->second);
+  } // lookup
+
+  IndexPtr indexFor(size_t key, const DOMNode& document, const XPathContext& context) const
+  {
+    Documents& documents = threadDocuments();
+    DocumentIndexesPtr indexes = documentFor(documents, document);
+    if(!indexes)
+    {
+      indexes.reset(new DocumentIndexes(document, all_.size()));
+      documents.push_front(indexes);
+      populate(*indexes, context);
+      evict(documents);
+    } // if ...
+
+    if(indexes->built[key])
+      return indexes->built[key];
+
+    // Only a use expression calling key() while the document is still being 
+    // indexed gets this far.  That key is indexed on its own, and a key 
+    // that ends up back here while that's going on gets what there is so far.
+    if(indexes->building[key])
+      return indexes->building[key];
+
+    IndexPtr index(new Index);
+    indexes->building[key] = index;
+    for(AxisEnum ae(document, XPath::DESCENDANT_OR_SELF); *ae != 0; ++ae)
+      if(all_[key]->matches(*ae, context))
+        all_[key]->index(index->nodes, *ae, context);
+    finish(*index);
+    indexes->building[key].reset();
+    indexes->built[key] = index;
+    return index;
+  } // indexFor
+
+  Documents& threadDocuments() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return documents_[std::this_thread::get_id()];
+  } // threadDocuments
+
+  static DocumentIndexesPtr documentFor(Documents& documents, const DOMNode& document)
+  {
+    for(typename Documents::iterator i = documents.begin(), ie = documents.end(); i != ie; ++i)
+      if((*i)->document == document)
+      {
+        documents.splice(documents.begin(), documents, i);
+        return *i;
+      } // if ...
+    return DocumentIndexesPtr();
+  } // documentFor
+
+  void populate(DocumentIndexes& indexes, const XPathContext& context) const
+  {
+    IndexList fresh;
+    for(size_t k = 0; k != all_.size(); ++k)
+      fresh.push_back(IndexPtr(new Index));
+    // each key takes a node once, however many of its patterns match it
+    std::vector<size_t> last(all_.size());
+    size_t count = 0;
+
+    for(AxisEnum ae(indexes.document, XPath::DESCENDANT_OR_SELF); *ae != 0; ++ae)
+    {
+      DOMNode node = *ae;
+      ++count;
+      const typename Patterns::Candidates& candidates = patterns_.candidates(node);
+      for(PatternIterator p = candidates.begin(), pe = candidates.end(); p != pe; ++p)
+      {
+        const size_t key = p->first;
+        if(last[key] != count && p->second->evaluate(node, context))
+        {
+          last[key] = count;
+          all_[key]->index(fresh[key]->nodes, node, context);
+        } // if ...
+      } // for ...
+    } // for 
+
+    for(size_t k = 0; k != all_.size(); ++k)
+    {
+      finish(*fresh[k]);
+      if(!indexes.built[k])
+        indexes.built[k] = fresh[k];
+    } // for ...
+  } // populate
+
+  static void finish(Index& index) 
+  {
+    for(typename NodeMap::iterator n = index.nodes.begin(), ne = index.nodes.end(); n != ne; ++n)
+      n->second.in_document_order();
+    index.none.in_document_order();
+  } // finish
+
+  void evict(Documents& documents) const
+  {
+    while(documents.size() > limit_)
+      documents.pop_back();
+  } // evict
+
+  typedef XPath::AxisEnumerator<string_type, string_adaptor> AxisEnum;
+
+  KeyList all_;
   Keys keys_;
+  Patterns patterns_;
+  std::atomic<size_t> limit_;
+  mutable ThreadDocuments documents_; // each thread's, most recently used first
+  mutable std::mutex mutex_; // guards documents_ itself, not the lists in it
 
   DeclaredKeys(const DeclaredKeys&);
   DeclaredKeys& operator=(const DeclaredKeys&);
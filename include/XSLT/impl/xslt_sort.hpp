@@ -2,6 +2,7 @@
 #define ARABICA_XSLT_SORT_HPP
 
 #include <algorithm>
+#include <vector>
 
 namespace Arabica
 {
@@ -15,6 +16,7 @@ class Sort
 public:
   typedef Arabica::XPath::XPathExpressionPtr<string_type, string_adaptor> XPathExpressionPtr;
   typedef DOM::Node<string_type, string_adaptor> DOMNode;
+  typedef Arabica::XPath::NodeSet<string_type, string_adaptor> NodeSet;
 
   Sort(const XPathExpressionPtr& select,
        const XPathExpressionPtr& lang, //="language-code"
@@ -35,39 +37,27 @@ public:
     delete sub_sort_;
   } // ~Sort
 
-  void set_context(const DOMNode& node, ExecutionContext<string_type, string_adaptor>& context)
+  // Every node's key for this sort and each of its sub-sorts is evaluated
+  // once, up front, and the nodes then put in the order the keys give.
+  void sort(const DOMNode& node, NodeSet& nodes, ExecutionContext<string_type, string_adaptor>& context) const
   {
-    context_ = &context;
-    const string_type datatype = datatype_->evaluateAsString(node, context_->xpathContext());
-    const string_type order = order_->evaluateAsString(node, context_->xpathContext());
-    const string_type caseorder = caseorder_->evaluateAsString(node, context_->xpathContext());
-
-    static AllowedValues<string_type> allowed_datatypes = makeAllowedValues(SC::text, SC::number);
-    static AllowedValues<string_type> allowed_orders = makeAllowedValues(SC::ascending, SC::descending);
-    static AllowedValues<string_type> allowed_case_orders = makeAllowedValues(SC::upper_first, SC::lower_first);
-    validate(SC::data_type, allowed_datatypes, datatype);
-    validate(SC::order, allowed_orders, order);
-    validate(SC::case_order, allowed_case_orders, caseorder);
-
-    if(datatype == SC::number)
-      if(order == SC::ascending)
-        sort_fn_ = &Sort::numberAscending;
-      else
-        sort_fn_ = &Sort::numberDescending;
-    else
-      if(order == SC::ascending)
-        sort_fn_ = &Sort::stringAscending;
-      else
-        sort_fn_ = &Sort::stringDescending;
+    std::vector<Keys> keys;
+    for(const Sort* s = this; s != 0; s = s->sub_sort_)
+      keys.push_back(s->evaluate(node, nodes, context));
+    if(nodes.size() < 2)
+      return;
 
-    if(sub_sort_)
-      sub_sort_->set_context(node, context);
-  } // set_context
+    std::vector<size_t> order(nodes.size());
+    for(size_t i = 0; i != order.size(); ++i)
+      order[i] = i;
+    std::stable_sort(order.begin(), order.end(), Compare(keys));
 
-  bool operator()(const DOMNode& n1, const DOMNode& n2) const
-  {
-    return (this->*sort_fn_)(n1, n2);
-  } // operator()
+    std::vector<DOMNode> sorted;
+    sorted.reserve(order.size());
+    for(size_t i = 0; i != order.size(); ++i)
+      sorted.push_back(nodes[order[i]]);
+    std::copy(sorted.begin(), sorted.end(), nodes.begin());
+  } // sort
 
   void add_sub_sort(Sort* sort)
   {
@@ -78,7 +68,7 @@ public:
   } // add_sub_sort
 
 private:
-  void validate(const string_type& name, const AllowedValues<string_type>& allowed, const string_type& value)
+  void validate(const string_type& name, const AllowedValues<string_type>& allowed, const string_type& value) const
   {
     if(allowed.is_allowed(value))
       return;
@@ -89,75 +79,86 @@ private:
 
   } // validate
 
-  typedef bool(Sort::*sortFn)(const DOMNode& n1, const DOMNode& n2) const;
-  bool numberAscending(const DOMNode& n1, const DOMNode& n2) const
-  {
-    return numberSort(n1, n2, nanAscending, std::less<double>());
-  } // numberAscending
-  bool numberDescending(const DOMNode& n1, const DOMNode& n2) const
+  // one sort's keys, in the order of the nodes they belong to
+  struct Keys
   {
-    return numberSort(n1, n2, nanDescending, std::greater<double>());
-  } // numberDescending
-  static bool nanAscending(bool, bool nan2) 
-  {
-    return !nan2;
-  } // nanAscending
-  static bool nanDescending(bool nan1, bool)
-  {
-    return !nan1;
-  } // nanDescending
-  template<class NanCompare, class NumberCompare>
-  bool numberSort(const DOMNode& n1, 
-                  const DOMNode& n2, 
-                  NanCompare nanCompare, 
-                  NumberCompare compare) const
+    bool number;
+    bool ascending;
+    std::vector<string_type> strings;
+    std::vector<double> numbers;
+  }; // struct Keys
+
+  Keys evaluate(const DOMNode& node, const NodeSet& nodes, ExecutionContext<string_type, string_adaptor>& context) const
   {
-    double v1 = grabAsNumber(n1);
-    double v2 = grabAsNumber(n2);
+    const string_type datatype = datatype_->evaluateAsString(node, context.xpathContext());
+    const string_type order = order_->evaluateAsString(node, context.xpathContext());
+    const string_type caseorder = caseorder_->evaluateAsString(node, context.xpathContext());
 
-    bool nan1 = Arabica::XPath::isNaN(v1);
-    bool nan2 = Arabica::XPath::isNaN(v2);
+    static AllowedValues<string_type> allowed_datatypes = makeAllowedValues(SC::text, SC::number);
+    static AllowedValues<string_type> allowed_orders = makeAllowedValues(SC::ascending, SC::descending);
+    static AllowedValues<string_type> allowed_case_orders = makeAllowedValues(SC::upper_first, SC::lower_first);
+    validate(SC::data_type, allowed_datatypes, datatype);
+    validate(SC::order, allowed_orders, order);
+    validate(SC::case_order, allowed_case_orders, caseorder);
 
-    if(((nan1 && nan2) || (v1 == v2)) && (sub_sort_))
-      return (*sub_sort_)(n1, n2);
+    Keys keys;
+    keys.number = (datatype == SC::number);
+    keys.ascending = (order == SC::ascending);
+    if(nodes.size() < 2)
+      return keys;
 
-    if(nan1 || nan2)
-      return nanCompare(nan1, nan2);
+    if(keys.number)
+      keys.numbers.reserve(nodes.size());
+    else
+      keys.strings.reserve(nodes.size());
+    for(typename NodeSet::const_iterator n = nodes.begin(), ne = nodes.end(); n != ne; ++n)
+    {
+      context.setPosition(*n, 1);
+      if(keys.number)
+        keys.numbers.push_back(select_->evaluateAsNumber(*n, context.xpathContext()));
+      else
+        keys.strings.push_back(select_->evaluateAsString(*n, context.xpathContext()));
+    } // for ...
+    return keys;
+  } // evaluate
 
-    return compare(v1, v2);
-  } // numberSort
-  bool stringAscending(const DOMNode& n1, const DOMNode& n2) const
-  {
-    return stringSort(n1, n2, std::less<string_type>());
-  } // stringAscending
-  bool stringDescending(const DOMNode& n1, const DOMNode& n2) const
-  {
-    return stringSort(n1, n2, std::greater<string_type>());
-  } // stringAscending
-  template<class StringCompare>
-  bool stringSort(const DOMNode& n1, 
-                  const DOMNode& n2, 
-                  StringCompare compare) const
+  // Orders two nodes, by their positions in the node list, on the first
+  // key they differ on.  NaN sorts first ascending and last descending.
+  class Compare
   {
-    string_type v1 = grabAsString(n1);
-    string_type v2 = grabAsString(n2);
+  public:
+    Compare(const std::vector<Keys>& keys) : keys_(keys) { }
 
-    if((v1 == v2) && (sub_sort_))
-      return (*sub_sort_)(n1, n2);
-
-    return compare(v1, v2);
-  } // stringSort
+    bool operator()(size_t n1, size_t n2) const
+    {
+      for(typename std::vector<Keys>::const_iterator k = keys_.begin(), ke = keys_.end(); k != ke; ++k)
+      {
+        if(k->number)
+        {
+          double v1 = k->numbers[n1];
+          double v2 = k->numbers[n2];
+          bool nan1 = Arabica::XPath::isNaN(v1);
+          bool nan2 = Arabica::XPath::isNaN(v2);
+
+          if((nan1 && nan2) || (v1 == v2))
+            continue;
+          if(nan1 || nan2)
+            return k->ascending ? !nan2 : !nan1;
+          return k->ascending ? (v1 < v2) : (v2 < v1);
+        } // if ...
+
+        const string_type& v1 = k->strings[n1];
+        const string_type& v2 = k->strings[n2];
+        if(v1 == v2)
+          continue;
+        return k->ascending ? (v1 < v2) : (v2 < v1);
+      } // for ...
+      return false;
+    } // operator()
 
-  string_type grabAsString(const DOMNode& n) const
-  {
-    context_->setPosition(n, 1);
-    return select_->evaluateAsString(n, context_->xpathContext());
-  } // grabAsString
-  double grabAsNumber(const DOMNode& n) const
-  {
-    context_->setPosition(n, 1);
-    return select_->evaluateAsNumber(n, context_->xpathContext());
-  } // grabAsString
+  private:
+    const std::vector<Keys>& keys_;
+  }; // class Compare
 
   XPathExpressionPtr select_;
   XPathExpressionPtr lang_;
@@ -165,8 +166,6 @@ private:
   XPathExpressionPtr order_;
   XPathExpressionPtr caseorder_;
   Sort* sub_sort_;
-  ExecutionContext<string_type, string_adaptor>* context_;
-  sortFn sort_fn_;
 
   Sort& operator=(const Sort&);
   bool operator==(const Sort&) const;
@@ -202,8 +201,7 @@ protected:
       return;
     }
 
-    sort_->set_context(node, context);
-    std::stable_sort(nodes.begin(), nodes.end(), SortP(*sort_));
+    sort_->sort(node, nodes, context);
   } // sort
 
   bool has_sort() const { return sort_ != 0; }
@@ -219,18 +217,6 @@ public:
 
 private:
   SortT* sort_;
-
-  struct SortP
-  {
-    SortP(SortT& sort) : sort_(sort) { }
-    bool operator()(const DOMNode& n1, const DOMNode& n2)
-    {
-      return sort_(n1, n2);
-    } // operator()
-
-  private:
-    SortT& sort_;
-  }; // struct SortP
 }; // class Sortable
 
 
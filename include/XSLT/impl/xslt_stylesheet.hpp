@@ -1,6 +1,8 @@
 #ifndef ARABICA_XSLT_STYLESHEET_HPP
 #define ARABICA_XSLT_STYLESHEET_HPP
 
+#include <memory>
+
 namespace Arabica
 {
 namespace XSLT
@@ -11,12 +13,50 @@ namespace XSLT
 #include <DOM/Node.hpp>
 template<class string_type, class string_adaptor> class Sink;
 
+// One run of a stylesheet - its parameters, where the output goes, and
+// where any messages go.  
+template<class string_type, class string_adaptor = Arabica::default_string_adaptor<string_type> >
+class Transformation
+{
+public:
+  virtual ~Transformation() { }
+
+  virtual void set_parameter(const string_type& name, bool value) = 0;
+  virtual void set_parameter(const string_type& name, double value) = 0;
+  virtual void set_parameter(const string_type& name, const char* value) = 0;
+  virtual void set_parameter(const string_type& name, const string_type& value) = 0;
+
+  virtual void set_output(Sink<string_type, string_adaptor>& sink) = 0;
+
+  virtual void set_error_output(std::basic_ostream<typename string_adaptor::value_type>& os) = 0;
+
+  virtual void execute(const DOM::Node<string_type, string_adaptor>& initialNode) const = 0;
+}; // class Transformation
+
 template<class string_type, class string_adaptor = Arabica::default_string_adaptor<string_type> >
 class Stylesheet
 {
 public:
   virtual ~Stylesheet() { }
 
+  // Each transformation holds its own settings, so any number of them can
+  // execute the same stylesheet at once, on different threads if need be.
+  virtual std::auto_ptr<Transformation<string_type, string_adaptor> > create_transformation() const = 0;
+
+  // The indexes xsl:key builds are kept for the documents each thread has
+  // most recently transformed - and those documents kept alive with them -
+  // until they are pushed out by others or the thread releases them here.
+  virtual void set_key_index_limit(size_t documents) = 0;
+  virtual void release_key_indexes(const DOM::Node<string_type, string_adaptor>& document) const = 0;
+
+  // A transformation parses each document document() loads once.  Files it
+  // loads can also be kept for later transformations on the same thread,
+  // whatever the stylesheet, and are parsed again once they have changed.
+  // Up to this many are kept - by default none.
+  virtual void set_shared_document_limit(size_t documents) const = 0;
+
+  // The settings and execute below belong to a transformation the 
+  // stylesheet keeps for itself, and so are not for concurrent use.
   virtual void set_parameter(const string_type& name, bool value) = 0;
   virtual void set_parameter(const string_type& name, double value) = 0;
   virtual void set_parameter(const string_type& name, const char* value) = 0;
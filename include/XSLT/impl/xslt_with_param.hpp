@@ -27,16 +27,13 @@ public:
   virtual void execute(const DOM::Node<string_type, string_adaptor>& node, 
                        ExecutionContext<string_type, string_adaptor>& context) const 
   {
-    name_ = context.passParam(node, *this);
+    context.passParam(node, *this);
   } // declare
 
   void unpass(ExecutionContext<string_type, string_adaptor>& context) const
   {
-    context.unpassParam(name_);
+    context.unpassParam(this->name());
   } // unpass
-
-private:
-  mutable string_type name_;
 }; // WithParam
 
 template<class string_type, class string_adaptor> class ParamPasser;
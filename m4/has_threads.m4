@@ -0,0 +1,32 @@
+AC_DEFUN([ARABICA_HAS_THREADS],
+[
+  AC_MSG_CHECKING([for the flags std::thread needs])
+  threads_save_CXXFLAGS="$CXXFLAGS"
+  threads_save_LIBS="$LIBS"
+  threads_flags=no
+  for flags in "none" "-pthread" "-lpthread"; do
+    case $flags in
+      none) ;;
+      -pthread) CXXFLAGS="$threads_save_CXXFLAGS -pthread"; LIBS="$threads_save_LIBS -pthread" ;;
+      *) CXXFLAGS="$threads_save_CXXFLAGS"; LIBS="$threads_save_LIBS $flags" ;;
+    esac
+    AC_LINK_IFELSE([AC_LANG_PROGRAM([[#include <thread>
+                                      void run() { }]],
+                                    [[std::thread t(run); t.join();]])],
+                   [threads_flags=$flags])
+    if test "$threads_flags" != no; then
+      break
+    fi
+  done
+  CXXFLAGS="$threads_save_CXXFLAGS"
+  LIBS="$threads_save_LIBS"
+  AC_MSG_RESULT([$threads_flags])
+
+  case $threads_flags in
+    -pthread) PTHREAD_CXXFLAGS="-pthread"; PTHREAD_LIBS="-pthread" ;;
+    -lpthread) PTHREAD_CXXFLAGS=""; PTHREAD_LIBS="-lpthread" ;;
+    *) PTHREAD_CXXFLAGS=""; PTHREAD_LIBS="" ;;
+  esac
+  AC_SUBST([PTHREAD_CXXFLAGS])
+  AC_SUBST([PTHREAD_LIBS])
+])
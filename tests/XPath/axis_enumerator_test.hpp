@@ -5,6 +5,7 @@
 #include "../CppUnit/framework/TestSuite.h"
 #include "../CppUnit/framework/TestCaller.h"
 
+#include <set>
 #include <XPath/XPath.hpp>
 #include <DOM/Simple/DOMImplementation.hpp>
 
@@ -778,6 +779,88 @@ public:
     assertTrue(*e == 0);
   } // namespaceAxisTest3
 
+  void namespaceAxisTest4()
+  {
+    const string_type xmlns = string_adaptor::construct_from_utf8("http://www.w3.org/2000/xmlns/");
+    root_.setAttributeNS(xmlns, string_adaptor::construct_from_utf8("xmlns:poop"), string_adaptor::construct_from_utf8("urn:test"));
+    root_.setAttributeNS(xmlns, string_adaptor::construct_from_utf8("xmlns"), string_adaptor::construct_from_utf8("urn:default"));
+    element2_.setAttributeNS(xmlns, string_adaptor::construct_from_utf8("xmlns:poop"), string_adaptor::construct_from_utf8("urn:inner"));
+    element2_.setAttributeNS(xmlns, string_adaptor::construct_from_utf8("xmlns"), string_adaptor::construct_from_utf8(""));
+
+    // an inner declaration hides the outer one, and xmlns="" removes the default
+    assertValuesEqual(3, namespaceCount(element1_));
+    assertValuesEqual(2, namespaceCount(element2_));
+    Arabica::XPath::AxisEnumerator<string_type, string_adaptor> e(element2_, Arabica::XPath::NAMESPACE);
+    ++e;
+    assertTrue(string_adaptor::construct_from_utf8("poop") == e->getLocalName());
+    assertTrue(string_adaptor::construct_from_utf8("urn:inner") == e->getNodeValue());
+    assertTrue(element2_ == e->getParentNode());
+
+    // a copy walks on by itself
+    Arabica::XPath::AxisEnumerator<string_type, string_adaptor> copy(e);
+    ++e;
+    assertTrue(*e == 0);
+    assertTrue(string_adaptor::construct_from_utf8("urn:inner") == copy->getNodeValue());
+    ++copy;
+    assertTrue(*copy == 0);
+
+    // nodes outlive the walk
+    Arabica::DOM::Node<string_type, string_adaptor> ns;
+    {
+      Arabica::XPath::AxisEnumerator<string_type, string_adaptor> w(element1_, Arabica::XPath::NAMESPACE);
+      ++w;
+      ns = *w;
+    }
+    assertTrue(string_adaptor::construct_from_utf8("poop") == ns.getLocalName());
+    assertTrue(string_adaptor::construct_from_utf8("urn:test") == ns.getNodeValue());
+
+    // changes to the declarations are seen
+    element2_.removeAttributeNS(xmlns, string_adaptor::construct_from_utf8("poop"));
+    assertValuesEqual(2, namespaceCount(element2_));
+    root_.removeAttributeNS(xmlns, string_adaptor::construct_from_utf8("poop"));
+    assertValuesEqual(1, namespaceCount(element2_));
+    assertValuesEqual(2, namespaceCount(element1_));
+    root_.removeChild(element1_);
+    assertValuesEqual(1, namespaceCount(element1_));
+  } // namespaceAxisTest4
+
+  void namespaceAxisTest5()
+  {
+    typedef Arabica::DOM::Node_impl<string_type, string_adaptor>* RawNode;
+    const string_type xmlns = string_adaptor::construct_from_utf8("http://www.w3.org/2000/xmlns/");
+    root_.setAttributeNS(xmlns, string_adaptor::construct_from_utf8("xmlns:poop"), string_adaptor::construct_from_utf8("urn:test"));
+
+    // dropped namespace nodes are handed out again
+    std::set<RawNode> walked;
+    for(Arabica::XPath::AxisEnumerator<string_type, string_adaptor> e(element1_, Arabica::XPath::NAMESPACE); *e != 0; ++e)
+      walked.insert((*e).underlying_impl());
+    assertValuesEqual(2, walked.size());
+    for(Arabica::XPath::AxisEnumerator<string_type, string_adaptor> e(element1_, Arabica::XPath::NAMESPACE); *e != 0; ++e)
+      assertValuesEqual(1, walked.count((*e).underlying_impl()));
+
+    // but not while they're still in use
+    Arabica::DOM::Node<string_type, string_adaptor> held;
+    {
+      Arabica::XPath::AxisEnumerator<string_type, string_adaptor> w(element1_, Arabica::XPath::NAMESPACE);
+      ++w;
+      held = *w;
+    }
+    for(int i = 0; i != 20; ++i)
+      for(Arabica::XPath::AxisEnumerator<string_type, string_adaptor> e(element2_, Arabica::XPath::NAMESPACE); *e != 0; ++e)
+        assertTrue(held.underlying_impl() != (*e).underlying_impl());
+    assertTrue(string_adaptor::construct_from_utf8("poop") == held.getLocalName());
+    assertTrue(string_adaptor::construct_from_utf8("urn:test") == held.getNodeValue());
+    assertTrue(element1_ == held.getParentNode());
+  } // namespaceAxisTest5
+
+  int namespaceCount(const Arabica::DOM::Node<string_type, string_adaptor>& node)
+  {
+    int count = 0;
+    for(Arabica::XPath::AxisEnumerator<string_type, string_adaptor> e(node, Arabica::XPath::NAMESPACE); *e != 0; ++e)
+      ++count;
+    return count;
+  } // namespaceCount
+
 }; // AxisEnumeratorTest
 
 template<class string_type, class string_adaptor>
@@ -975,6 +1058,8 @@ TestSuite* NamespaceAxisTest_suite()
   suite->addTest(new TestCaller<AxisEnumeratorTest<string_type, string_adaptor> >("namespaceAxisTest1", &AxisEnumeratorTest<string_type, string_adaptor>::namespaceAxisTest1));
   suite->addTest(new TestCaller<AxisEnumeratorTest<string_type, string_adaptor> >("namespaceAxisTest2", &AxisEnumeratorTest<string_type, string_adaptor>::namespaceAxisTest2));
   suite->addTest(new TestCaller<AxisEnumeratorTest<string_type, string_adaptor> >("namespaceAxisTest3", &AxisEnumeratorTest<string_type, string_adaptor>::namespaceAxisTest3));
+  suite->addTest(new TestCaller<AxisEnumeratorTest<string_type, string_adaptor> >("namespaceAxisTest4", &AxisEnumeratorTest<string_type, string_adaptor>::namespaceAxisTest4));
+  suite->addTest(new TestCaller<AxisEnumeratorTest<string_type, string_adaptor> >("namespaceAxisTest5", &AxisEnumeratorTest<string_type, string_adaptor>::namespaceAxisTest5));
 
   return suite;
 } // NamespaceAxisTest_suite
@@ -5,6 +5,7 @@
 #include "../CppUnit/framework/TestSuite.h"
 #include "../CppUnit/framework/TestCaller.h"
 
+#include <thread>
 #include <XPath/XPath.hpp>
 #include <DOM/Simple/DOMImplementation.hpp>
 
@@ -92,6 +93,107 @@ public:
   } // resolveFunction
 }; // class TestFunctionResolver
 
+// Collects the nodes a path streams, stopping after limit of them
+template<class string_type, class string_adaptor>
+class NodeCollector : public Arabica::XPath::impl::NodeVisitor<string_type, string_adaptor>
+{
+public:
+  NodeCollector(bool ordered, size_t limit) : ordered_(ordered), limit_(limit) { }
+
+  virtual bool visit(const Arabica::DOM::Node<string_type, string_adaptor>& node)
+  {
+    nodes.push_back(node);
+    return nodes.size() != limit_;
+  } // visit
+  virtual bool needsDocumentOrder() const { return ordered_; }
+
+  std::vector<Arabica::DOM::Node<string_type, string_adaptor> > nodes;
+
+private:
+  const bool ordered_;
+  const size_t limit_;
+}; // class NodeCollector
+
+// Evaluates a set of shared, compiled expressions against a document of its
+// own.  Run on several threads at once by testConcurrentEvaluation.
+template<class string_type, class string_adaptor>
+class ConcurrentEvaluation
+{
+  typedef string_adaptor SA;
+public:
+  typedef std::vector<Arabica::XPath::XPathExpression<string_type, string_adaptor> > Expressions;
+  typedef std::vector<string_type> Results;
+
+  ConcurrentEvaluation(const Expressions& expressions, const Results& expected, int thread, int runs, int* failures) :
+      expressions_(expressions), expected_(expected), thread_(thread), runs_(runs), failures_(failures) { }
+
+  void operator()() const
+  {
+    try {
+      Arabica::DOM::Document<string_type, string_adaptor> doc = buildDocument();
+      for(int r = 0; r != runs_; ++r)
+      {
+        Results results = evaluate(expressions_, thread_, doc);
+        for(size_t e = 0; e != results.size(); ++e)
+          if(!(results[e] == expected_[e]))
+            ++*failures_;
+      } // for ...
+    }
+    catch(...) {
+      ++*failures_;
+    } // catch
+  } // operator()
+
+  static Results evaluate(const Expressions& expressions, int thread, const Arabica::DOM::Document<string_type, string_adaptor>& doc)
+  {
+    using namespace Arabica::XPath;
+    const char* digits[] = { "0", "1", "2", "3", "4", "5", "6", "7", "8", "9" };
+    StringVariableResolver<string_type, string_adaptor> svr;
+    svr.setVariable(SA::construct_from_utf8("offset"), SA::construct_from_utf8(digits[thread % 10]));
+    svr.setVariable(SA::construct_from_utf8("pattern"), SA::construct_from_utf8((thread % 2) ? "[0-9]$" : "^[a-c]"));
+    ExecutionContext<string_type, string_adaptor> context;
+    context.setVariableResolver(svr);
+
+    Results results;
+    for(typename Expressions::const_iterator e = expressions.begin(), ee = expressions.end(); e != ee; ++e)
+      results.push_back(e->evaluateAsString(doc, context));
+    // the single argument form makes its own execution context
+    results.push_back(expressions.front().evaluateAsString(doc));
+    return results;
+  } // evaluate
+
+  static Arabica::DOM::Document<string_type, string_adaptor> buildDocument()
+  {
+    using namespace Arabica::DOM;
+    const char* types[] = { "a", "b", "c" };
+    const char* values[] = { "a", "1", "b", "2.5", "x" };
+    const char* numbers[] = { "0", "1", "2", "3", "4", "5", "6", "7", "8", "9" };
+
+    DOMImplementation<string_type, string_adaptor> factory = Arabica::SimpleDOM::DOMImplementation<string_type, string_adaptor>::getDOMImplementation();
+    Document<string_type, string_adaptor> doc = factory.createDocument(SA::construct_from_utf8("urn:test"), SA::construct_from_utf8("t:items"), 0);
+    Element<string_type, string_adaptor> root = doc.getDocumentElement();
+    root.setAttributeNS(SA::construct_from_utf8("http://www.w3.org/2000/xmlns/"), SA::construct_from_utf8("xmlns:t"), SA::construct_from_utf8("urn:test"));
+    for(int i = 0; i != 40; ++i)
+    {
+      Element<string_type, string_adaptor> item = doc.createElement(SA::construct_from_utf8("item"));
+      string_type n = SA::construct_from_utf8(numbers[i / 10]);
+      SA::append(n, SA::construct_from_utf8(numbers[i % 10]));
+      item.setAttribute(SA::construct_from_utf8("n"), n);
+      item.setAttribute(SA::construct_from_utf8("type"), SA::construct_from_utf8(types[i % 3]));
+      item.appendChild(doc.createTextNode(SA::construct_from_utf8(values[i % 5])));
+      root.appendChild(item);
+    } // for ...
+    return doc;
+  } // buildDocument
+
+private:
+  const Expressions& expressions_;
+  const Results& expected_;
+  const int thread_;
+  const int runs_;
+  int* const failures_;
+}; // class ConcurrentEvaluation
+
 template<class string_type, class string_adaptor>
 class ExecuteTest : public TestCase
 {
@@ -414,6 +516,94 @@ public:
     parser.resetVariableResolver();
   } // test18
 
+  void test18a()
+  {
+    using namespace Arabica::XPath;
+    SlotVariableResolver<string_type, string_adaptor> svr;
+    svr.setVariable(SA::construct_from_utf8("index"), StringValue<string_type, string_adaptor>::createValue(SA::construct_from_utf8("1")));
+
+    parser.setVariableCompileTimeResolver(svr);
+    parser.setVariableResolver(svr);
+    XPathExpression<string_type, string_adaptor> xpath = parser.compile(SA::construct_from_utf8("/root/*[@two = $index]"));
+    ExecutionContext<string_type, string_adaptor> context;
+    context.setVariableResolver(svr);
+    XPathValue<string_type, string_adaptor> result = xpath.evaluate(document_, context);
+    assertValuesEqual(NODE_SET, result.type());
+    assertValuesEqual(1, result.asNodeSet().size());
+    assertTrue(element2_ == result.asNodeSet()[0]);
+
+    svr.setVariable(SA::construct_from_utf8("index"), StringValue<string_type, string_adaptor>::createValue(SA::construct_from_utf8("2")));
+    result = xpath.evaluate(document_, context);
+    assertValuesEqual(0, result.asNodeSet().size());
+
+    try {
+      parser.evaluate_expr(SA::construct_from_utf8("$unset"), document_);
+      assertTrue(false);
+    }
+    catch(const UnboundVariableException&) { }
+
+    parser.resetVariableResolver();
+    parser.resetVariableCompileTimeResolver();
+  } // test18a
+
+  void test18b()
+  {
+    using namespace Arabica::XPath;
+    // compiled to a slot, but run against a resolver that works by name
+    SlotVariableResolver<string_type, string_adaptor> slots;
+    StringVariableResolver<string_type, string_adaptor> svr;
+    svr.setVariable(SA::construct_from_utf8("index"), SA::construct_from_utf8("1"));
+
+    parser.setVariableCompileTimeResolver(slots);
+    parser.setVariableResolver(svr);
+    XPathValue<string_type, string_adaptor> result = parser.evaluate(SA::construct_from_utf8("/root/*[@two = $index]"), document_);
+    assertValuesEqual(NODE_SET, result.type());
+    assertValuesEqual(1, result.asNodeSet().size());
+    assertTrue(element2_ == result.asNodeSet()[0]);
+
+    parser.resetVariableResolver();
+    parser.resetVariableCompileTimeResolver();
+  } // test18b
+
+  // a resolver made on the stack here is likely to be at the same address
+  // each time, but is never taken for one made on an earlier call
+  string_type evaluateWithSlots(Arabica::XPath::XPathExpression<string_type, string_adaptor>& xpath, const char* expr, const char** names)
+  {
+    using namespace Arabica::XPath;
+    SlotVariableResolver<string_type, string_adaptor> slots;
+    for(int n = 0; names[n] != 0; ++n)
+      slots.setVariable(SA::construct_from_utf8(names[n]), StringValue<string_type, string_adaptor>::createValue(SA::construct_from_utf8(names[n])));
+    if(expr != 0)
+    {
+      parser.setVariableCompileTimeResolver(slots);
+      xpath = parser.compile_expr(SA::construct_from_utf8(expr));
+      parser.resetVariableCompileTimeResolver();
+    } // if ...
+
+    ExecutionContext<string_type, string_adaptor> context;
+    context.setVariableResolver(slots);
+    return xpath.evaluateAsString(document_, context);
+  } // evaluateWithSlots
+
+  void test18c()
+  {
+    using namespace Arabica::XPath;
+    const char* compiled[] = { "a", "b", "c", 0 };
+    const char* fewer[] = { "c", 0 };
+    const char* reordered[] = { "z", "y", "x", "c", 0 };
+
+    XPathExpression<string_type, string_adaptor> xpath;
+    assertTrue(SA::construct_from_utf8("c") == evaluateWithSlots(xpath, "$c", compiled));
+    assertTrue(SA::construct_from_utf8("c") == evaluateWithSlots(xpath, 0, fewer));
+    assertTrue(SA::construct_from_utf8("c") == evaluateWithSlots(xpath, 0, reordered));
+    
+    try {
+      evaluateWithSlots(xpath, 0, compiled + 3);
+      assertTrue(false);
+    }
+    catch(const UnboundVariableException&) { }
+  } // test18c
+
   void test19()
   {
     using namespace Arabica::XPath;
@@ -903,6 +1093,42 @@ public:
     assertTrue(element3_ == result.asNodeSet()[0]);
   } // testUnion14
 
+  void testUnion15()
+  {
+    using namespace Arabica::XPath;
+    XPathValue<string_type, string_adaptor> result = parser.evaluate_expr(SA::construct_from_utf8("/root/child3|/root/child1"), root_);
+    assertValuesEqual(NODE_SET, result.type());
+    assertValuesEqual(2, result.asNodeSet().size());
+    assertTrue(element1_ == result.asNodeSet()[0]);
+    assertTrue(element3_ == result.asNodeSet()[1]);
+  } // testUnion15
+
+  void testUnion16()
+  {
+    using namespace Arabica::XPath;
+    XPathValue<string_type, string_adaptor> result = parser.evaluate_expr(SA::construct_from_utf8("/root/child2/node()|/root/*|//spinkle"), root_);
+    assertValuesEqual(NODE_SET, result.type());
+    assertValuesEqual(7, result.asNodeSet().size());
+    assertTrue(element1_ == result.asNodeSet()[0]);
+    assertTrue(element2_ == result.asNodeSet()[1]);
+    assertTrue(text_ == result.asNodeSet()[2]);
+    assertTrue(spinkle_ == result.asNodeSet()[3]);
+    assertTrue(comment_ == result.asNodeSet()[4]);
+    assertTrue(processingInstruction_ == result.asNodeSet()[5]);
+    assertTrue(element3_ == result.asNodeSet()[6]);
+  } // testUnion16
+
+  void testUnion17()
+  {
+    using namespace Arabica::XPath;
+    XPathValue<string_type, string_adaptor> result = parser.evaluate_expr(SA::construct_from_utf8("/root/child3/preceding-sibling::*|//spinkle/ancestor::*"), root_);
+    assertValuesEqual(NODE_SET, result.type());
+    assertValuesEqual(3, result.asNodeSet().size());
+    assertTrue(root_ == result.asNodeSet()[0]);
+    assertTrue(element1_ == result.asNodeSet()[1]);
+    assertTrue(element2_ == result.asNodeSet()[2]);
+  } // testUnion17
+
   void testPlus1()
   {
     using namespace Arabica::XPath;
@@ -998,6 +1224,35 @@ public:
     assertTrue(element2_ == result.asNodeSet()[0]);
   } // testNodeSetEquality9
 
+  void testNodeSetEquality10()
+  {
+    using namespace Arabica::XPath;
+    assertValuesEqual(true, parser.evaluate_expr(SA::construct_from_utf8("/doc/number[. > 2] = /doc/number[. < 4]"), numbers_).asBool());
+    assertValuesEqual(true, parser.evaluate_expr(SA::construct_from_utf8("/doc/number[. < 4] = /doc/number[. > 2]"), numbers_).asBool());
+    assertValuesEqual(true, parser.evaluate_expr(SA::construct_from_utf8("/doc/number = /doc/number[5]"), numbers_).asBool());
+    assertValuesEqual(false, parser.evaluate_expr(SA::construct_from_utf8("/doc/number[. > 7] = /doc/number[. < 3]"), numbers_).asBool());
+    assertValuesEqual(false, parser.evaluate_expr(SA::construct_from_utf8("/doc/number = /doc/nothing"), numbers_).asBool());
+  } // testNodeSetEquality10
+
+  void testNodeSetEquality11()
+  {
+    using namespace Arabica::XPath;
+    assertValuesEqual(true, parser.evaluate_expr(SA::construct_from_utf8("/doc/number[1] != /doc/number"), numbers_).asBool());
+    assertValuesEqual(true, parser.evaluate_expr(SA::construct_from_utf8("/doc/number != /doc/number[1]"), numbers_).asBool());
+    assertValuesEqual(false, parser.evaluate_expr(SA::construct_from_utf8("/doc/number[1] != /doc/number[1]"), numbers_).asBool());
+    assertValuesEqual(false, parser.evaluate_expr(SA::construct_from_utf8("/doc/number != /doc/nothing"), numbers_).asBool());
+  } // testNodeSetEquality11
+
+  void testNodeSetEquality12()
+  {
+    using namespace Arabica::XPath;
+    assertValuesEqual(true, parser.evaluate_expr(SA::construct_from_utf8("/doc/number[. < 3] < /doc/number[. > 7]"), numbers_).asBool());
+    assertValuesEqual(false, parser.evaluate_expr(SA::construct_from_utf8("/doc/number[. > 7] < /doc/number[. < 3]"), numbers_).asBool());
+    assertValuesEqual(true, parser.evaluate_expr(SA::construct_from_utf8("/doc/number[. > 2] <= /doc/number[. < 4]"), numbers_).asBool());
+    assertValuesEqual(false, parser.evaluate_expr(SA::construct_from_utf8("/doc/number[1] > /doc/number"), numbers_).asBool());
+    assertValuesEqual(false, parser.evaluate_expr(SA::construct_from_utf8("/doc/number < /doc/nothing"), numbers_).asBool());
+  } // testNodeSetEquality12
+
   void testCountFn1()
   {
     using namespace Arabica::XPath;
@@ -1973,6 +2228,35 @@ public:
     assertValuesEqual(false, result.asBool());
   } // testMatchesFn13
 
+  void testMatchesFn14()
+  {
+    using namespace Arabica::XPath;
+    XPathValue<string_type, string_adaptor> result = parser.evaluate_expr(SA::construct_from_utf8("count(/doc/number[matches('1357', .)])"), numbers_);
+    assertValuesEqual(NUMBER, result.type());
+    assertValuesEqual(4.0, result.asNumber());
+  } // testMatchesFn14
+
+  void testMatchesFn15()
+  {
+    using namespace Arabica::XPath;
+    // more distinct patterns than the cache holds
+    XPathValue<string_type, string_adaptor> result = parser.evaluate_expr(SA::construct_from_utf8("count(/doc/number/following-sibling::number[matches(concat(., position()), concat('^', ., position(), '$'))])"), numbers_);
+    assertValuesEqual(8.0, result.asNumber());
+    result = parser.evaluate_expr(SA::construct_from_utf8("count(/doc/number/following-sibling::number[matches(concat(., position()), concat('^', ., position(), 'x$'))])"), numbers_);
+    assertValuesEqual(0.0, result.asNumber());
+  } // testMatchesFn15
+
+  void testMatchesFn16()
+  {
+    using namespace Arabica::XPath;
+    XPathExpression<string_type, string_adaptor> xpath = parser.compile_expr(SA::construct_from_utf8("matches('A', 'a', 'q')"));
+    try {
+      xpath.evaluate(document_);
+      assertTrue(false);
+    }
+    catch(const SyntaxException&) { }
+  } // testMatchesFn16
+
   void testLocalNameFn1()
   {
     using namespace Arabica::XPath;
@@ -2586,6 +2870,60 @@ public:
     assertValuesEqual(3, result.asNodeSet().size());
   } // namespaceAxisTest3
 
+  void testPositional1()
+  {
+    using namespace Arabica::XPath;
+    assertTrue(element2_ == parser.evaluate(SA::construct_from_utf8("child1/following-sibling::*[1]"), root_).asNodeSet()[0]);
+    assertTrue(element3_ == parser.evaluate(SA::construct_from_utf8("child1/following-sibling::*[last()]"), root_).asNodeSet()[0]);
+    assertTrue(element2_ == parser.evaluate(SA::construct_from_utf8("child3/preceding-sibling::*[1]"), root_).asNodeSet()[0]);
+    assertTrue(element1_ == parser.evaluate(SA::construct_from_utf8("child3/preceding-sibling::*[last()]"), root_).asNodeSet()[0]);
+    assertTrue(processingInstruction_ == parser.evaluate(SA::construct_from_utf8("child2/node()[last()]"), root_).asNodeSet()[0]);
+    assertTrue(spinkle_ == parser.evaluate(SA::construct_from_utf8("child2/node()[2]"), root_).asNodeSet()[0]);
+    assertValuesEqual(0, parser.evaluate(SA::construct_from_utf8("child2/node()[5]"), root_).asNodeSet().size());
+    assertValuesEqual(0, parser.evaluate(SA::construct_from_utf8("child3/following-sibling::*[1]"), root_).asNodeSet().size());
+    assertTrue(root_ == parser.evaluate(SA::construct_from_utf8("//spinkle/ancestor::*[last()]"), root_).asNodeSet()[0]);
+    assertValuesEqual(1, parser.evaluate(SA::construct_from_utf8("*[last()][not(@one)]"), root_).asNodeSet().size());
+    assertValuesEqual(0, parser.evaluate(SA::construct_from_utf8("*[last()][1][@one]"), root_).asNodeSet().size());
+  } // testPositional1
+
+  bool sameNodes(const Arabica::XPath::NodeSet<string_type, string_adaptor>& lhs, 
+                 const Arabica::XPath::NodeSet<string_type, string_adaptor>& rhs)
+  {
+    if(lhs.size() != rhs.size())
+      return false;
+    for(size_t i = 0; i != lhs.size(); ++i)
+      if(lhs[i] != rhs[i])
+        return false;
+    return true;
+  } // sameNodes
+
+  void testPositional2()
+  {
+    using namespace Arabica::XPath;
+    // a run of adjacent text nodes counts as one
+    element3_.appendChild(document_.createTextNode(SA::construct_from_utf8("one")));
+    element3_.appendChild(document_.createTextNode(SA::construct_from_utf8("two")));
+    element3_.appendChild(document_.createElement(SA::construct_from_utf8("middle")));
+    element3_.appendChild(document_.createCDATASection(SA::construct_from_utf8("three")));
+    element3_.appendChild(document_.createTextNode(SA::construct_from_utf8("four")));
+
+    const char* axes[] = { "ancestor", "ancestor-or-self", "attribute", "child", "descendant", "descendant-or-self", 
+                           "following", "following-sibling", "parent", "preceding", "preceding-sibling", "self", 0 };
+    const char* positions[][2] = { { "[1]", "[position() = 1]" }, 
+                                   { "[2]", "[position() = 2]" }, 
+                                   { "[last()]", "[position() = last()]" }, 
+                                   { 0, 0 } };
+    NodeSet<string_type, string_adaptor> contexts = parser.evaluate_expr(SA::construct_from_utf8("//node() | //@*"), document_).asNodeSet();
+    for(const char** axis = axes; *axis != 0; ++axis)
+      for(size_t p = 0; positions[p][0] != 0; ++p)
+      {
+        string_type fast = SA::construct_from_utf8((std::string(*axis) + "::node()" + positions[p][0]).c_str());
+        string_type slow = SA::construct_from_utf8((std::string(*axis) + "::node()" + positions[p][1]).c_str());
+        for(size_t c = 0; c != contexts.size(); ++c)
+          assertTrue(sameNodes(parser.evaluate(slow, contexts[c]).asNodeSet(), parser.evaluate(fast, contexts[c]).asNodeSet()));
+      } // for ...
+  } // testPositional2
+
   void testFunctionResolver1()
   {
     try {
@@ -2637,6 +2975,389 @@ public:
     assertTrue(element2_ == ns[1]);
     assertTrue(element3_ == ns[2]);
   } // testSort2
+
+  void testNameIndex1()
+  {
+    using namespace Arabica::XPath;
+    XPathExpression<string_type, string_adaptor> xpath = parser.compile(SA::construct_from_utf8("//chapter"));
+
+    NodeSet<string_type, string_adaptor> chapters = xpath.evaluateAsNodeSet(chapters_);
+    assertValuesEqual(5, chapters.size());
+    assertTrue(SA::construct_from_utf8("one") == chapters[0].getFirstChild().getNodeValue());
+    assertTrue(SA::construct_from_utf8("five") == chapters[4].getFirstChild().getNodeValue());
+
+    // index must notice the tree has changed
+    Arabica::DOM::Node<string_type, string_adaptor> extra = chapters_.createElement(SA::construct_from_utf8("chapter"));
+    Arabica::DOM::Node<string_type, string_adaptor> two = chapters[1];
+    two.appendChild(extra);
+    chapters_.getFirstChild().removeChild(chapters[4]);
+
+    chapters = xpath.evaluateAsNodeSet(chapters_);
+    assertValuesEqual(5, chapters.size());
+    assertTrue(extra == chapters[2]);
+    assertTrue(SA::construct_from_utf8("four") == chapters[4].getFirstChild().getNodeValue());
+  } // testNameIndex1
+
+  void testNameIndex2()
+  {
+    using namespace Arabica::XPath;
+    assertValuesEqual(1, parser.evaluate(SA::construct_from_utf8("//spinkle"), document_).asNodeSet().size());
+    assertValuesEqual(1, parser.evaluate(SA::construct_from_utf8("//spinkle"), element3_).asNodeSet().size());
+    assertValuesEqual(0, parser.evaluate(SA::construct_from_utf8("//spinkles"), document_).asNodeSet().size());
+    assertValuesEqual(4, parser.evaluate(SA::construct_from_utf8("//child2/@*"), document_).asNodeSet().size());
+    assertValuesEqual(2, parser.evaluate_expr(SA::construct_from_utf8("count(//child1 | //child3)"), document_).asNumber());
+
+    Arabica::DOM::DocumentFragment<string_type, string_adaptor> frag = document_.createDocumentFragment();
+    frag.appendChild(document_.createElement(SA::construct_from_utf8("spinkle")));
+    assertValuesEqual(1, parser.evaluate(SA::construct_from_utf8("//spinkle"), frag).asNodeSet().size());
+  } // testNameIndex2
+
+  void testNameIndex3()
+  {
+    using namespace Arabica::XPath;
+    Arabica::DOM::Element<string_type, string_adaptor> ns1 = document_.createElementNS(SA::construct_from_utf8("urn:test"), SA::construct_from_utf8("t:spinkle"));
+    Arabica::DOM::Element<string_type, string_adaptor> ns2 = document_.createElementNS(SA::construct_from_utf8("urn:test"), SA::construct_from_utf8("spinkle"));
+    element1_.appendChild(ns1);
+    element3_.appendChild(ns2);
+
+    StandardNamespaceContext<string_type, string_adaptor> nsContext;
+    nsContext.addNamespaceDeclaration(SA::construct_from_utf8("urn:test"), SA::construct_from_utf8("x"));
+    parser.setNamespaceContext(nsContext);
+    XPathExpression<string_type, string_adaptor> xpath = parser.compile(SA::construct_from_utf8("//x:spinkle"));
+    parser.resetNamespaceContext();
+
+    NodeSet<string_type, string_adaptor> spinkles = xpath.evaluateAsNodeSet(document_);
+    assertValuesEqual(2, spinkles.size());
+    assertTrue(ns1 == spinkles[0]);
+    assertTrue(ns2 == spinkles[1]);
+
+    spinkles = parser.evaluate(SA::construct_from_utf8("//spinkle"), document_).asNodeSet();
+    assertValuesEqual(1, spinkles.size());
+    assertTrue(spinkle_ == spinkles[0]);
+  } // testNameIndex3
+
+  void testAttributeIndex1()
+  {
+    using namespace Arabica::XPath;
+    assertTrue(Arabica::SimpleDOM::setAttributeIndexing(document_, true));
+    XPathExpression<string_type, string_adaptor> xpath = parser.compile(SA::construct_from_utf8("//*[@one='1']"));
+
+    NodeSet<string_type, string_adaptor> ones = xpath.evaluateAsNodeSet(document_);
+    assertValuesEqual(2, ones.size());
+    assertTrue(element1_ == ones[0]);
+    assertTrue(element2_ == ones[1]);
+    assertValuesEqual(1, parser.evaluate(SA::construct_from_utf8("//child2[@two='1']"), document_).asNodeSet().size());
+    assertValuesEqual(0, parser.evaluate(SA::construct_from_utf8("//child1[@two='1']"), document_).asNodeSet().size());
+    assertValuesEqual(1, parser.evaluate(SA::construct_from_utf8("//*['1'=@four]"), document_).asNodeSet().size());
+    assertValuesEqual(0, parser.evaluate(SA::construct_from_utf8("//*[@one='2']"), document_).asNodeSet().size());
+
+    // index must notice attributes being added, removed and changed
+    element3_.setAttribute(SA::construct_from_utf8("one"), SA::construct_from_utf8("1"));
+    ones = xpath.evaluateAsNodeSet(document_);
+    assertValuesEqual(3, ones.size());
+    assertTrue(element3_ == ones[2]);
+
+    element1_.removeAttribute(SA::construct_from_utf8("one"));
+    ones = xpath.evaluateAsNodeSet(document_);
+    assertValuesEqual(2, ones.size());
+    assertTrue(element2_ == ones[0]);
+
+    element2_.getAttributeNode(SA::construct_from_utf8("one")).setValue(SA::construct_from_utf8("2"));
+    element3_.setAttribute(SA::construct_from_utf8("one"), SA::construct_from_utf8("2"));
+    assertValuesEqual(0, xpath.evaluateAsNodeSet(document_).size());
+    assertValuesEqual(2, parser.evaluate(SA::construct_from_utf8("//*[@one='2']"), document_).asNodeSet().size());
+
+    root_.removeChild(element3_);
+    assertValuesEqual(1, parser.evaluate(SA::construct_from_utf8("//*[@one='2']"), document_).asNodeSet().size());
+  } // testAttributeIndex1
+
+  void testAttributeIndex2()
+  {
+    using namespace Arabica::XPath;
+    element3_.setAttribute(SA::construct_from_utf8("one"), SA::construct_from_utf8("3"));
+    spinkle_.setAttribute(SA::construct_from_utf8("one"), SA::construct_from_utf8("1"));
+
+    NodeSetVariableResolver<string_type, string_adaptor> nsvr;
+    NodeSet<string_type, string_adaptor> attrs;
+    attrs.push_back(element3_.getAttributeNode(SA::construct_from_utf8("one")));
+    attrs.push_back(attr_);
+    nsvr.setVariable(SA::construct_from_utf8("attrs"), attrs);
+    StringVariableResolver<string_type, string_adaptor> svr;
+    svr.setVariable(SA::construct_from_utf8("value"), SA::construct_from_utf8("1"));
+
+    const char* paths[] = { "//*[@one='1']", "//*[@one=1]", "//child2[@one='1']", "//spinkle[@one='1']", "//*[@one='1'][2]",
+                            "//*[@one=$value]", "//child1[$value=@one]", "//*[@one=$attrs]", "//child3[@one=$attrs]", 0 };
+    for(int i = 0; paths[i] != 0; ++i)
+    {
+      if(std::string(paths[i]).find("attrs") != std::string::npos)
+        parser.setVariableResolver(nsvr);
+      else
+        parser.setVariableResolver(svr);
+
+      Arabica::SimpleDOM::setAttributeIndexing(document_, false);
+      NodeSet<string_type, string_adaptor> walked = parser.evaluate(SA::construct_from_utf8(paths[i]), document_).asNodeSet();
+      Arabica::SimpleDOM::setAttributeIndexing(document_, true);
+      assertTrue(sameNodes(walked, parser.evaluate(SA::construct_from_utf8(paths[i]), document_).asNodeSet()));
+      assertTrue(!walked.empty());
+    } // for ...
+    parser.resetVariableResolver();
+  } // testAttributeIndex2
+
+  bool sameNumber(double lhs, double rhs)
+  {
+    return (lhs == rhs) || (Arabica::XPath::isNaN(lhs) && Arabica::XPath::isNaN(rhs));
+  } // sameNumber
+
+  void testBytecode1()
+  {
+    using namespace Arabica::XPath;
+    typedef impl::BytecodeExpression<string_type, string_adaptor> Bytecode;
+    const char* exprs[] = { ". = 'data'", ". != 'data'", ". > 0", ". = .", "@one = '1'", "@one = 1", "@two != 1", "@missing != 'x'", 
+                            "@one < @two", "@one >= .", "string-length(.) > 1 + 1 or false()", "contains(concat(., 'x'), 'ax')", 
+                            "starts-with(concat(@one, name()), '1c')", "number(@one) + 1", "-@one mod 2", "floor(. div 2) - last()",
+                            "round(string-length(name()) div 3) * ceiling(-0.5)", "not(@one) and boolean(.)", 
+                            "concat(@one, '-', ., '-', 1 div 0, true())", "string(@one = 1) = 'true'", "number() = number(string())",
+                            "(@one or @two) = (. = 'data')", "count(*) + 1 = position()", 0 };
+    Arabica::DOM::Node<string_type, string_adaptor> contexts[] = { document_, root_, element1_, element2_, element3_, spinkle_,
+                                                                   text_, attr_, comment_, processingInstruction_ };
+    ExecutionContext<string_type, string_adaptor> executionContext;
+    for(int i = 0; exprs[i] != 0; ++i)
+    {
+      XPathExpression<string_type, string_adaptor> xpath = parser.compile_expr(SA::construct_from_utf8(exprs[i]));
+      const Bytecode* bytecode = dynamic_cast<const Bytecode*>(xpath.get());
+      assertTrue(bytecode != 0);
+      for(int c = 0; c != 10; ++c)
+      {
+        assertTrue(bytecode->tree()->evaluateAsString(contexts[c], executionContext) == xpath.evaluateAsString(contexts[c], executionContext));
+        assertTrue(bytecode->tree()->evaluateAsBool(contexts[c], executionContext) == xpath.evaluateAsBool(contexts[c], executionContext));
+        assertTrue(sameNumber(bytecode->tree()->evaluateAsNumber(contexts[c], executionContext), xpath.evaluateAsNumber(contexts[c], executionContext)));
+      } // for ...
+    } // for ...
+  } // testBytecode1
+
+  // @name wanted only for whether it's there, or converted to a number,
+  // mustn't hold on to registers, or a longer expression runs out and
+  // drops back to the tree
+  void testBytecodeRegisters()
+  {
+    using namespace Arabica::XPath;
+    typedef impl::BytecodeExpression<string_type, string_adaptor> Bytecode;
+    const char* exprs[] = { "@one or @two or @a or @b or @c or @d or @e or @f or @g or @h",
+                            "boolean(@one) and not(@two) or @a and @b or @c and @d or @e and @f or @g and @h",
+                            "number(@one) + @two + @a = 1 or @b or @c or @d or @e or @f or @g or @h or @i", 
+                            "(@one + @two) * (@a + @b) * (@c + @d) * (@e + @f) * (@g + @h) * (@i + @j) * (@k + @l) * (@m + @n) * (@o + @p)", 0 };
+    Arabica::DOM::Node<string_type, string_adaptor> contexts[] = { root_, element1_, element2_, element3_ };
+    ExecutionContext<string_type, string_adaptor> executionContext;
+    for(int i = 0; exprs[i] != 0; ++i)
+    {
+      XPathExpression<string_type, string_adaptor> xpath = parser.compile_expr(SA::construct_from_utf8(exprs[i]));
+      const Bytecode* bytecode = dynamic_cast<const Bytecode*>(xpath.get());
+      assertTrue(bytecode != 0);
+      for(int c = 0; c != 4; ++c)
+      {
+        assertTrue(bytecode->tree()->evaluateAsBool(contexts[c], executionContext) == xpath.evaluateAsBool(contexts[c], executionContext));
+        assertTrue(sameNumber(bytecode->tree()->evaluateAsNumber(contexts[c], executionContext), xpath.evaluateAsNumber(contexts[c], executionContext)));
+      } // for ...
+    } // for ...
+  } // testBytecodeRegisters
+
+  void testBytecode2()
+  {
+    using namespace Arabica::XPath;
+    NodeSet<string_type, string_adaptor> result = parser.evaluate(SA::construct_from_utf8("/root/*[. = 'data']"), document_).asNodeSet();
+    assertValuesEqual(1, result.size());
+    assertTrue(result[0] == element2_);
+
+    result = parser.evaluate(SA::construct_from_utf8("/root/*[not(@two) and position() != 2]"), document_).asNodeSet();
+    assertValuesEqual(2, result.size());
+    assertTrue(result[0] == element1_);
+    assertTrue(result[1] == element3_);
+
+    result = parser.evaluate(SA::construct_from_utf8("/root/*[@one = 1][@two]"), document_).asNodeSet();
+    assertValuesEqual(1, result.size());
+    assertTrue(result[0] == element2_);
+
+    result = parser.evaluate(SA::construct_from_utf8("/document/chapter[string-length(.) > 3]"), chapters_).asNodeSet();
+    assertValuesEqual(3, result.size());
+    assertTrue(SA::construct_from_utf8("three") == result[0].getFirstChild().getNodeValue());
+
+    result = parser.evaluate(SA::construct_from_utf8("/doc/number[. mod 2 = 0][position() = last()]"), numbers_).asNodeSet();
+    assertValuesEqual(1, result.size());
+    assertTrue(SA::construct_from_utf8("8") == result[0].getFirstChild().getNodeValue());
+
+    result = parser.evaluate(SA::construct_from_utf8("/doc/number[. > 3 and . <= 5 or last() - 1 = position()]"), numbers_).asNodeSet();
+    assertValuesEqual(3, result.size());
+    assertTrue(SA::construct_from_utf8("8") == result[2].getFirstChild().getNodeValue());
+  } // testBytecode2
+
+  void testConcurrentEvaluation()
+  {
+    using namespace Arabica::XPath;
+    typedef ConcurrentEvaluation<string_type, string_adaptor> Evaluation;
+    const char* sources[] = { 
+      "count(//item[@type = 'b'])",
+      "sum(//item[position() mod 2 = 0]/@n)",
+      "string(//item[last()])",
+      "boolean(//item[. = 'x'])",
+      "concat(name(/*), '-', count(//*))",
+      "count(//item[@n > $offset])",
+      "string(//item[@n = $offset + 3]/@type)",
+      "matches(string(//item[position() = $offset + 1]), $pattern)",
+      "count(//namespace::*)",
+      "string-length(normalize-space(/))",
+      "//item[@n mod 5 = 0][last()] = 'x'",
+      0 
+    };
+    const int threads = 8;
+    const int runs = 25;
+
+    typename Evaluation::Expressions expressions;
+    for(const char** s = sources; *s != 0; ++s)
+      expressions.push_back(parser.compile_expr(SA::construct_from_utf8(*s)));
+
+    std::vector<typename Evaluation::Results> expected;
+    for(int t = 0; t != threads; ++t)
+      expected.push_back(Evaluation::evaluate(expressions, t, Evaluation::buildDocument()));
+    assertTrue(expected[0][7] == SA::construct_from_utf8("true"));
+    assertTrue(expected[1][7] == SA::construct_from_utf8("true"));
+    assertTrue(expected[3][5] == SA::construct_from_utf8("36"));
+
+    std::vector<int> failures(threads);
+    std::vector<std::thread> workers;
+    for(int t = 0; t != threads; ++t)
+      workers.push_back(std::thread(Evaluation(expressions, expected[t], t, runs, &failures[t])));
+    for(int t = 0; t != threads; ++t)
+      workers[t].join();
+
+    for(int t = 0; t != threads; ++t)
+      assertValuesEqual(0, failures[t]);
+  } // testConcurrentEvaluation
+
+  Arabica::DOM::Document<string_type, string_adaptor> nestedDocument()
+  {
+    using namespace Arabica::DOM;
+    Document<string_type, string_adaptor> doc = factory_.createDocument(SA::construct_from_utf8(""), SA::construct_from_utf8("r"), 0);
+    Element<string_type, string_adaptor> r = doc.getDocumentElement();
+    r.setAttributeNS(SA::construct_from_utf8("http://www.w3.org/2000/xmlns/"), SA::construct_from_utf8("xmlns:p"), SA::construct_from_utf8("urn:p"));
+    Element<string_type, string_adaptor> a1 = appendElement(r, "a", "0.1");
+    appendElement(a1, "b", "10000000000000000");
+    Element<string_type, string_adaptor> a2 = appendElement(a1, "a", "0.1");
+    appendElement(a2, "b", "0.1");
+    appendElement(a2, "b", "-10000000000000000");
+    appendElement(a1, "b", "0.3");
+    Element<string_type, string_adaptor> c = appendElement(r, "c", "2");
+    appendElement(appendElement(c, "a", "0.7"), "b", "0.2");
+    return doc;
+  } // nestedDocument
+
+  Arabica::DOM::Element<string_type, string_adaptor> appendElement(Arabica::DOM::Element<string_type, string_adaptor> parent, const char* name, const char* n)
+  {
+    Arabica::DOM::Element<string_type, string_adaptor> e = parent.getOwnerDocument().createElement(SA::construct_from_utf8(name));
+    e.setAttribute(SA::construct_from_utf8("n"), SA::construct_from_utf8(n));
+    e.appendChild(parent.getOwnerDocument().createTextNode(SA::construct_from_utf8(n)));
+    parent.appendChild(e);
+    return e;
+  } // appendElement
+
+  // namespace nodes are made afresh each time they're walked over
+  bool sameNode(const Arabica::DOM::Node<string_type, string_adaptor>& lhs, const Arabica::DOM::Node<string_type, string_adaptor>& rhs)
+  {
+    if(lhs.getNodeType() == Arabica::XPath::NAMESPACE_NODE_TYPE)
+      return (rhs.getNodeType() == Arabica::XPath::NAMESPACE_NODE_TYPE) && (lhs.getParentNode() == rhs.getParentNode()) &&
+             (lhs.getNodeName() == rhs.getNodeName()) && (lhs.getNodeValue() == rhs.getNodeValue());
+    return lhs == rhs;
+  } // sameNode
+
+  void testStreamingAggregates1()
+  {
+    using namespace Arabica::XPath;
+    const char* paths[] = { "//b", "//a/b", "//a//b", "/r/a/b/@n", "//b/@n", "//@n", "a/b", "//a/..", "//b/ancestor::*", 
+                            "descendant::*/following-sibling::*", "//*/namespace::*", "//a[b]/b[2]", "/r/*/*", "a/a/b[last()]", 
+                            "self::node()/descendant-or-self::a", "//a[1]", "preceding::*", "//b[. > 0]/@n", "*/b/text()", 
+                            "descendant::a/b", "//c/descendant::b", "ancestor-or-self::*/a", "//missing", "(//a)[2]/b", 
+                            "ancestor::*", "ancestor-or-self::*/@n", "preceding-sibling::*", "preceding::*/@n", "@*", 0 };
+    Arabica::DOM::Document<string_type, string_adaptor> doc = nestedDocument();
+    Arabica::DOM::Node<string_type, string_adaptor> deepest = doc.getDocumentElement().getFirstChild().getFirstChild().getNextSibling().getLastChild();
+    Arabica::DOM::Node<string_type, string_adaptor> contexts[] = { doc, doc.getDocumentElement(), doc.getDocumentElement().getFirstChild(), deepest };
+    ExecutionContext<string_type, string_adaptor> executionContext;
+    for(int i = 0; paths[i] != 0; ++i)
+    {
+      string_type path = SA::construct_from_utf8(paths[i]);
+      string_type count = SA::construct_from_utf8("count(");
+      SA::append(count, path);
+      SA::append(count, SA::construct_from_utf8(")"));
+      string_type sum = SA::construct_from_utf8("sum(");
+      SA::append(sum, path);
+      SA::append(sum, SA::construct_from_utf8(")"));
+      string_type boolean = SA::construct_from_utf8("boolean(");
+      SA::append(boolean, path);
+      SA::append(boolean, SA::construct_from_utf8(")"));
+      string_type negated = SA::construct_from_utf8("not(");
+      SA::append(negated, path);
+      SA::append(negated, SA::construct_from_utf8(")"));
+
+      for(int c = 0; c != 4; ++c)
+      {
+        NodeSet<string_type, string_adaptor> nodes = parser.evaluate_expr(path, contexts[c]).asNodeSet();
+        NodeCollector<string_type, string_adaptor> ordered(true, 0);
+        parser.compile_expr(path).get()->stream(contexts[c], executionContext, ordered);
+        assertValuesEqual(nodes.size(), ordered.nodes.size());
+        for(size_t n = 0; n != nodes.size(); ++n)
+          assertTrue(sameNode(nodes[n], ordered.nodes[n]));
+
+        double expected = 0;
+        for(typename NodeSet<string_type, string_adaptor>::const_iterator n = nodes.begin(), ne = nodes.end(); n != ne; ++n)
+          expected += impl::nodeNumberValue<string_type, string_adaptor>(*n);
+
+        assertValuesEqual(nodes.size(), parser.evaluate_expr(count, contexts[c]).asNumber());
+        assertTrue(sameNumber(expected, parser.evaluate_expr(sum, contexts[c]).asNumber()));
+        assertValuesEqual(!nodes.empty(), parser.evaluate_expr(boolean, contexts[c]).asBool());
+        assertValuesEqual(nodes.empty(), parser.evaluate_expr(negated, contexts[c]).asBool());
+        assertValuesEqual(!nodes.empty(), parser.compile_expr(path).evaluateAsBool(contexts[c]));
+      } // for ...
+    } // for ...
+
+    // the ancestors come back nearest first, but are added up in document order
+    Arabica::DOM::Element<string_type, string_adaptor> a = factory_.createDocument(SA::construct_from_utf8(""), SA::construct_from_utf8("a"), 0).getDocumentElement();
+    a.setAttribute(SA::construct_from_utf8("n"), SA::construct_from_utf8("10000000000000000"));
+    Arabica::DOM::Element<string_type, string_adaptor> b = appendElement(a, "b", "1");
+    Arabica::DOM::Element<string_type, string_adaptor> c = appendElement(b, "c", "1");
+    assertTrue(sameNumber(10000000000000000.0, parser.evaluate_expr(SA::construct_from_utf8("sum(ancestor-or-self::*/@n)"), c).asNumber()));
+    assertTrue(parser.evaluate_expr(SA::construct_from_utf8("sum(ancestor-or-self::*/@n) = sum(//@n)"), c).asBool());
+  } // testStreamingAggregates1
+
+  void testStreamingAggregates2()
+  {
+    using namespace Arabica::XPath;
+    Arabica::DOM::Document<string_type, string_adaptor> doc = nestedDocument();
+    ExecutionContext<string_type, string_adaptor> executionContext;
+
+    const char* paths[] = { "//b", "/r/a/b/@n", "//a//b", "//a/b", "//a/b/@n", 0 };
+    for(int i = 0; paths[i] != 0; ++i)
+    {
+      XPathExpression<string_type, string_adaptor> path = parser.compile(SA::construct_from_utf8(paths[i]));
+      NodeSet<string_type, string_adaptor> nodes = path.evaluateAsNodeSet(doc);
+
+      // streamed in the order the node-set holds them
+      NodeCollector<string_type, string_adaptor> ordered(true, 0);
+      assertTrue(path.get()->stream(doc, executionContext, ordered));
+      assertValuesEqual(nodes.size(), ordered.nodes.size());
+      for(size_t n = 0; n != nodes.size(); ++n)
+        assertTrue(nodes[n] == ordered.nodes[n]);
+
+      // in any order, but each node once
+      NodeCollector<string_type, string_adaptor> unordered(false, 0);
+      assertTrue(path.get()->stream(doc, executionContext, unordered));
+      assertValuesEqual(nodes.size(), unordered.nodes.size());
+      for(size_t n = 0; n != unordered.nodes.size(); ++n)
+        assertValuesEqual(1, std::count(unordered.nodes.begin(), unordered.nodes.end(), nodes[n]));
+
+      // stopped early
+      NodeCollector<string_type, string_adaptor> first(false, 2);
+      assertTrue(!path.get()->stream(doc, executionContext, first));
+      assertValuesEqual(2, first.nodes.size());
+    } // for ...
+  } // testStreamingAggregates2
 }; // class ExecuteTest
 
 template<class string_type, class string_adaptor>
@@ -2662,6 +3383,9 @@ TestSuite* ExecuteTest_suite()
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("test16", &ExecuteTest<string_type, string_adaptor>::test16));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("test17", &ExecuteTest<string_type, string_adaptor>::test17));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("test18", &ExecuteTest<string_type, string_adaptor>::test18));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("test18a", &ExecuteTest<string_type, string_adaptor>::test18a));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("test18b", &ExecuteTest<string_type, string_adaptor>::test18b));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("test18c", &ExecuteTest<string_type, string_adaptor>::test18c));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("test19", &ExecuteTest<string_type, string_adaptor>::test19));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("test20", &ExecuteTest<string_type, string_adaptor>::test20));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("test21", &ExecuteTest<string_type, string_adaptor>::test21));
@@ -2702,6 +3426,9 @@ TestSuite* ExecuteTest_suite()
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testUnion12", &ExecuteTest<string_type, string_adaptor>::testUnion12));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testUnion13", &ExecuteTest<string_type, string_adaptor>::testUnion13));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testUnion14", &ExecuteTest<string_type, string_adaptor>::testUnion14));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testUnion15", &ExecuteTest<string_type, string_adaptor>::testUnion15));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testUnion16", &ExecuteTest<string_type, string_adaptor>::testUnion16));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testUnion17", &ExecuteTest<string_type, string_adaptor>::testUnion17));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testPlus1", &ExecuteTest<string_type, string_adaptor>::testPlus1));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testPlus2", &ExecuteTest<string_type, string_adaptor>::testPlus2));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testNodeSetEquality1", &ExecuteTest<string_type, string_adaptor>::testNodeSetEquality1));
@@ -2713,6 +3440,9 @@ TestSuite* ExecuteTest_suite()
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testNodeSetEquality7", &ExecuteTest<string_type, string_adaptor>::testNodeSetEquality7));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testNodeSetEquality8", &ExecuteTest<string_type, string_adaptor>::testNodeSetEquality8));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testNodeSetEquality9", &ExecuteTest<string_type, string_adaptor>::testNodeSetEquality9));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testNodeSetEquality10", &ExecuteTest<string_type, string_adaptor>::testNodeSetEquality10));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testNodeSetEquality11", &ExecuteTest<string_type, string_adaptor>::testNodeSetEquality11));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testNodeSetEquality12", &ExecuteTest<string_type, string_adaptor>::testNodeSetEquality12));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testCountFn1", &ExecuteTest<string_type, string_adaptor>::testCountFn1));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testCountFn2", &ExecuteTest<string_type, string_adaptor>::testCountFn2));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testCountFn3", &ExecuteTest<string_type, string_adaptor>::testCountFn3));
@@ -2834,6 +3564,9 @@ TestSuite* ExecuteTest_suite()
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testMatchesFn11", &ExecuteTest<string_type, string_adaptor>::testMatchesFn11));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testMatchesFn12", &ExecuteTest<string_type, string_adaptor>::testMatchesFn12));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testMatchesFn13", &ExecuteTest<string_type, string_adaptor>::testMatchesFn13));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testMatchesFn14", &ExecuteTest<string_type, string_adaptor>::testMatchesFn14));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testMatchesFn15", &ExecuteTest<string_type, string_adaptor>::testMatchesFn15));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testMatchesFn16", &ExecuteTest<string_type, string_adaptor>::testMatchesFn16));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testLocalNameFn1", &ExecuteTest<string_type, string_adaptor>::testLocalNameFn1));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testLocalNameFn2", &ExecuteTest<string_type, string_adaptor>::testLocalNameFn2));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testLocalNameFn3", &ExecuteTest<string_type, string_adaptor>::testLocalNameFn3));
@@ -2897,10 +3630,23 @@ TestSuite* ExecuteTest_suite()
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("namespaceAxisTest1", &ExecuteTest<string_type, string_adaptor>::namespaceAxisTest1));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("namespaceAxisTest2", &ExecuteTest<string_type, string_adaptor>::namespaceAxisTest2));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("namespaceAxisTest3", &ExecuteTest<string_type, string_adaptor>::namespaceAxisTest3));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testPositional1", &ExecuteTest<string_type, string_adaptor>::testPositional1));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testPositional2", &ExecuteTest<string_type, string_adaptor>::testPositional2));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testFunctionResolver1", &ExecuteTest<string_type, string_adaptor>::testFunctionResolver1));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testFunctionResolver2", &ExecuteTest<string_type, string_adaptor>::testFunctionResolver2));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testSort1", &ExecuteTest<string_type, string_adaptor>::testSort1));
   suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testSort2", &ExecuteTest<string_type, string_adaptor>::testSort2));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testNameIndex1", &ExecuteTest<string_type, string_adaptor>::testNameIndex1));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testNameIndex2", &ExecuteTest<string_type, string_adaptor>::testNameIndex2));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testNameIndex3", &ExecuteTest<string_type, string_adaptor>::testNameIndex3));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testAttributeIndex1", &ExecuteTest<string_type, string_adaptor>::testAttributeIndex1));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testAttributeIndex2", &ExecuteTest<string_type, string_adaptor>::testAttributeIndex2));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testBytecode1", &ExecuteTest<string_type, string_adaptor>::testBytecode1));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testBytecodeRegisters", &ExecuteTest<string_type, string_adaptor>::testBytecodeRegisters));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testBytecode2", &ExecuteTest<string_type, string_adaptor>::testBytecode2));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testConcurrentEvaluation", &ExecuteTest<string_type, string_adaptor>::testConcurrentEvaluation));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testStreamingAggregates1", &ExecuteTest<string_type, string_adaptor>::testStreamingAggregates1));
+  suiteOfTests->addTest(new TestCaller<ExecuteTest<string_type, string_adaptor> >("testStreamingAggregates2", &ExecuteTest<string_type, string_adaptor>::testStreamingAggregates2));
  
   return suiteOfTests;
 } // ExecuteTest_suite
@@ -393,6 +393,32 @@ public:
     assertEquals(0, matchPriority("foo"), 0);
   } // testPriority4
 
+  void testNodeTypeAndName()
+  {
+    using namespace Arabica::XPath;
+    Arabica::XPath::StandardNamespaceContext<string_type, string_adaptor> nsContext;
+    nsContext.addNamespaceDeclaration(SA::construct_from_utf8("bang"), SA::construct_from_utf8("bang"));
+    parser.setNamespaceContext(nsContext);
+
+    assertTrue(matchKey("element", Arabica::DOM::Node_base::ELEMENT_NODE, "", "element"));
+    assertTrue(matchKey("element[@ref]", Arabica::DOM::Node_base::ELEMENT_NODE, "", "element"));
+    assertTrue(matchKey("/element/child", Arabica::DOM::Node_base::ELEMENT_NODE, "", "child"));
+    assertTrue(matchKey("//element//child", Arabica::DOM::Node_base::ELEMENT_NODE, "", "child"));
+    assertTrue(matchKey("bang:*/bang:child", Arabica::DOM::Node_base::ELEMENT_NODE, "bang", "child"));
+    assertTrue(matchKey("element/*", Arabica::DOM::Node_base::ELEMENT_NODE, 0, 0));
+    assertTrue(matchKey("bang:*", Arabica::DOM::Node_base::ELEMENT_NODE, 0, 0));
+    assertTrue(matchKey("@hello", Arabica::DOM::Node_base::ATTRIBUTE_NODE, "", "hello"));
+    assertTrue(matchKey("child::element/@bang:child", Arabica::DOM::Node_base::ATTRIBUTE_NODE, "bang", "child"));
+    assertTrue(matchKey("@*", Arabica::DOM::Node_base::ATTRIBUTE_NODE, 0, 0));
+    assertTrue(matchKey("text()", Arabica::DOM::Node_base::TEXT_NODE, 0, 0));
+    assertTrue(matchKey("comment()", Arabica::DOM::Node_base::COMMENT_NODE, 0, 0));
+    assertTrue(matchKey("processing-instruction('noon')", Arabica::DOM::Node_base::PROCESSING_INSTRUCTION_NODE, 0, 0));
+    assertTrue(matchKey("node()", 0, 0, 0));
+    assertTrue(matchKey("id('nob')", 0, 0, 0));
+
+    parser.resetNamespaceContext();
+  } // testNodeTypeAndName
+
   void testIdKey()
   {
     assertTrue(compileThis("id('nob')"));
@@ -413,6 +439,40 @@ public:
     assertTrue(dontCompileThis("key(a, 'b')"));
   } // testIdKey2
 
+  void testMatchIndex()
+  {
+    const char* patterns[] = { "node()", "item", "@id", "text()", "*", "other", "item", "@*", 0 };
+    Arabica::XPath::MatchIndex<int, string_type, string_adaptor> index;
+    assertTrue(index.empty());
+    for(int p = 0; patterns[p] != 0; ++p)
+      index.add(compileMatch(patterns[p]), p);
+    assertFalse(index.empty());
+
+    Arabica::DOM::Document<string_type, string_adaptor> doc = parseXML("<doc><item id='1'>text<!--c--></item><other ref='2'/></doc>");
+    Arabica::DOM::Element<string_type, string_adaptor> item = static_cast<Arabica::DOM::Element<string_type, string_adaptor> >(doc.getDocumentElement().getFirstChild());
+    Arabica::DOM::Element<string_type, string_adaptor> other = static_cast<Arabica::DOM::Element<string_type, string_adaptor> >(item.getNextSibling());
+
+    // each list in the order added, with only the patterns that could match
+    assertEquals("0,1,4,6,", candidates(index, item));
+    assertEquals("0,4,5,", candidates(index, other));
+    assertEquals("0,4,", candidates(index, doc.getDocumentElement()));
+    assertEquals("0,2,7,", candidates(index, item.getAttributeNode(SA::construct_from_utf8("id"))));
+    assertEquals("0,7,", candidates(index, other.getAttributeNode(SA::construct_from_utf8("ref"))));
+    assertEquals("0,3,", candidates(index, item.getFirstChild()));
+    assertEquals("0,", candidates(index, item.getLastChild()));
+    assertEquals("0,", candidates(index, doc));
+  } // testMatchIndex
+
+  std::string candidates(const Arabica::XPath::MatchIndex<int, string_type, string_adaptor>& index,
+                         const Arabica::DOM::Node<string_type, string_adaptor>& node)
+  {
+    std::ostringstream ss;
+    const std::vector<int>& c = index.candidates(node);
+    for(size_t i = 0; i != c.size(); ++i)
+      ss << c[i] << ",";
+    return ss.str();
+  } // candidates
+
   bool dontCompileThis(const char* path)
   {
     try {
@@ -448,6 +508,15 @@ public:
     return matches[0];
   } // compileMatch
 
+  bool matchKey(const char* match, int type, const char* uri, const char* name)
+  {
+    Arabica::XPath::MatchExpr<string_type, string_adaptor> m = compileMatch(match);
+    if(m.node_type() != type || m.has_name() != (name != 0))
+      return false;
+    return (name == 0) ||
+           ((m.name_uri() == SA::construct_from_utf8(uri)) && (m.name() == SA::construct_from_utf8(name)));
+  } // matchKey
+
   double matchPriority(const char* match)
   {
     compileMatches(match);
@@ -513,8 +582,10 @@ TestSuite* MatchTest_suite()
   suiteOfTests->addTest(new TestCaller<MatchTest<string_type, string_adaptor> >("testPriority2", &MatchTest<string_type, string_adaptor>::testPriority2));
   suiteOfTests->addTest(new TestCaller<MatchTest<string_type, string_adaptor> >("testPriority3", &MatchTest<string_type, string_adaptor>::testPriority3));
   suiteOfTests->addTest(new TestCaller<MatchTest<string_type, string_adaptor> >("testPriority4", &MatchTest<string_type, string_adaptor>::testPriority4));
+  suiteOfTests->addTest(new TestCaller<MatchTest<string_type, string_adaptor> >("testNodeTypeAndName", &MatchTest<string_type, string_adaptor>::testNodeTypeAndName));
   suiteOfTests->addTest(new TestCaller<MatchTest<string_type, string_adaptor> >("testIdKey", &MatchTest<string_type, string_adaptor>::testIdKey));
   suiteOfTests->addTest(new TestCaller<MatchTest<string_type, string_adaptor> >("testIdKey2", &MatchTest<string_type, string_adaptor>::testIdKey2));
+  suiteOfTests->addTest(new TestCaller<MatchTest<string_type, string_adaptor> >("testMatchIndex", &MatchTest<string_type, string_adaptor>::testMatchIndex));
  
   return suiteOfTests;
 } // MatchTest_suite
@@ -418,6 +418,88 @@ public:
     }
     catch(...) { }
   } // test25
+
+  bool isConstant(const Arabica::XPath::XPathExpression<string_type>& xpath)
+  {
+    return dynamic_cast<const Arabica::XPath::impl::ConstantValue<string_type, Arabica::default_string_adaptor<string_type> >*>(xpath.get()) != 0;
+  } // isConstant
+
+  bool folded(const char* expr)
+  {
+    return isConstant(parser.compile_expr(SA::construct_from_utf8(expr)));
+  } // folded
+
+  void test26()
+  {
+    assertTrue(folded("1 + 2 * 3"));
+    assertTrue(folded("-(4 div 2)"));
+    assertTrue(folded("concat('a', 'b', string-length('abc'))"));
+    assertTrue(folded("1 = 1.0"));
+    assertTrue(folded("not(true()) or 'x' != 'y'"));
+    assertTrue(folded("false() and child"));
+    assertTrue(folded("true() or child"));
+
+    assertFalse(folded("true() and child"));
+    assertFalse(folded("child = 1"));
+    assertFalse(folded("string-length()"));
+    assertFalse(folded("position() = 1"));
+    assertFalse(folded("1 + last()"));
+    assertFalse(folded("count(child)"));
+
+    Arabica::DOM::Node<string_type> none;
+    assertTrue(SA::construct_from_utf8("ab3") == parser.compile_expr(SA::construct_from_utf8("concat('a', 'b', string-length('abc'))")).evaluateAsString(none));
+    assertValuesEqual(7.0, parser.compile_expr(SA::construct_from_utf8("1 + 2 * 3")).evaluateAsNumber(none));
+    assertValuesEqual(Arabica::XPath::BOOL, parser.compile_expr(SA::construct_from_utf8("false() and child")).type());
+    assertValuesEqual(Arabica::XPath::NUMBER, parser.compile_expr(SA::construct_from_utf8("-(4 div 2)")).type());
+  } // test26
+
+  void test27()
+  {
+    Arabica::DOM::Node<string_type> none;
+    Arabica::XPath::XPathExpression<string_type> avt = parser.compile_attribute_value_template(SA::construct_from_utf8("a{{b}}{1 + 2}c"));
+    assertTrue(isConstant(avt));
+    assertTrue(SA::construct_from_utf8("a{b}3c") == avt.evaluateAsString(none));
+
+    avt = parser.compile_attribute_value_template(SA::construct_from_utf8("{{{name(/)}}}"));
+    assertFalse(isConstant(avt));
+  } // test27
+
+  bool isResolved(const Arabica::XPath::XPathExpression<string_type>& xpath)
+  {
+    return dynamic_cast<const Arabica::XPath::impl::ResolvedFunctionHolder<string_type, Arabica::default_string_adaptor<string_type> >*>(xpath.get()) != 0;
+  } // isResolved
+
+  bool isFunction(const Arabica::XPath::XPathExpression<string_type>& xpath)
+  {
+    return dynamic_cast<const Arabica::XPath::impl::FunctionHolder<string_type, Arabica::default_string_adaptor<string_type> >*>(xpath.get()) != 0;
+  } // isFunction
+
+  void test28()
+  {
+    Arabica::XPath::XPathExpression<string_type> fn = parser.compile_expr(SA::construct_from_utf8("string-length(child)"));
+    assertTrue(isFunction(fn));
+    assertFalse(isResolved(fn));
+
+    Arabica::XPath::StandardNamespaceContext<string_type> nsContext;
+    nsContext.addNamespaceDeclaration(SA::construct_from_utf8("something"), SA::construct_from_utf8("p"));
+    parser.setNamespaceContext(nsContext);
+    TrueFunctionResolver<string_type, string_adaptor> tfr;
+    parser.setFunctionResolver(tfr);
+
+    fn = parser.compile_expr(SA::construct_from_utf8("p:true()"));
+    assertTrue(isResolved(fn));
+    assertTrue(fn.evaluateAsBool(Arabica::DOM::Node<string_type>()));
+    assertFalse(isResolved(parser.compile_expr(SA::construct_from_utf8("true()"))));
+
+    parser.resetNamespaceContext();
+    parser.resetFunctionResolver();
+
+    try {
+      parser.compile_expr(SA::construct_from_utf8("string-lengthx(child)"));
+      assertTrue(false);
+    }
+    catch(const Arabica::XPath::UndefinedFunctionException&) { }
+  } // test28
 }; // class ParseTest
 
 template<class string_type, class string_adaptor>
@@ -451,6 +533,9 @@ TestSuite* ParseTest_suite()
   suiteOfTests->addTest(new TestCaller<ParseTest<string_type, string_adaptor> >("test23", &ParseTest<string_type, string_adaptor>::test23));
   suiteOfTests->addTest(new TestCaller<ParseTest<string_type, string_adaptor> >("test24", &ParseTest<string_type, string_adaptor>::test24));
   suiteOfTests->addTest(new TestCaller<ParseTest<string_type, string_adaptor> >("test25", &ParseTest<string_type, string_adaptor>::test25));
+  suiteOfTests->addTest(new TestCaller<ParseTest<string_type, string_adaptor> >("test26", &ParseTest<string_type, string_adaptor>::test26));
+  suiteOfTests->addTest(new TestCaller<ParseTest<string_type, string_adaptor> >("test27", &ParseTest<string_type, string_adaptor>::test27));
+  suiteOfTests->addTest(new TestCaller<ParseTest<string_type, string_adaptor> >("test28", &ParseTest<string_type, string_adaptor>::test28));
 
   return suiteOfTests;
 } // ParseTest_suite
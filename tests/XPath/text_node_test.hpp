@@ -130,6 +130,23 @@ public:
     assertTrue(SA::construct_from_utf8("onetwothreefourfivesixseven") == value);
   } // test5a
 
+  void test5b()
+  {
+    extraSetUp();
+    Node_t foo = root_.getFirstChild().getNextSibling().getNextSibling().getNextSibling();
+    foo.appendChild(document_.createTextNode(SA::construct_from_utf8("in")));
+    assertTrue(SA::construct_from_utf8("in") == parser_.evaluate_expr(SA::construct_from_utf8("string(/root/foo)"), document_).asString());
+
+    foo.appendChild(document_.createComment(SA::construct_from_utf8("not me")));
+    Node_t bar = foo.appendChild(document_.createElement(SA::construct_from_utf8("bar")));
+    bar.appendChild(document_.createCDATASection(SA::construct_from_utf8("side")));
+    assertTrue(SA::construct_from_utf8("inside") == parser_.evaluate_expr(SA::construct_from_utf8("string(/root/foo)"), document_).asString());
+    assertTrue(SA::construct_from_utf8("") == parser_.evaluate_expr(SA::construct_from_utf8("string(/root/boo)"), document_).asString());
+
+    string_type value = parser_.evaluate(SA::construct_from_utf8("/root"), document_).asString();
+    assertTrue(SA::construct_from_utf8("onetwothreeinsidefourfivesixseven") == value);
+  } // test5b
+
   void testNodeTest()
   {
     XPathValue_t nodes = parser_.evaluate(SA::construct_from_utf8("/root/node()"), document_);
@@ -264,6 +281,7 @@ TestSuite* TextNodeTest_suite()
   suiteOfTests->addTest(new TestCaller<TextNodeTest<string_type, string_adaptor> >("test4", &TextNodeTest<string_type, string_adaptor>::test4));
   suiteOfTests->addTest(new TestCaller<TextNodeTest<string_type, string_adaptor> >("test5", &TextNodeTest<string_type, string_adaptor>::test5));
   suiteOfTests->addTest(new TestCaller<TextNodeTest<string_type, string_adaptor> >("test5a", &TextNodeTest<string_type, string_adaptor>::test5a));
+  suiteOfTests->addTest(new TestCaller<TextNodeTest<string_type, string_adaptor> >("test5b", &TextNodeTest<string_type, string_adaptor>::test5b));
   suiteOfTests->addTest(new TestCaller<TextNodeTest<string_type, string_adaptor> >("testNodeTest", &TextNodeTest<string_type, string_adaptor>::testNodeTest));
   suiteOfTests->addTest(new TestCaller<TextNodeTest<string_type, string_adaptor> >("testDescendantOrSelf", &TextNodeTest<string_type, string_adaptor>::testDescendantOrSelf));
   suiteOfTests->addTest(new TestCaller<TextNodeTest<string_type, string_adaptor> >("testDescendant", &TextNodeTest<string_type, string_adaptor>::testDescendant));
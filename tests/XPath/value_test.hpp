@@ -169,6 +169,63 @@ public:
     assertTrue(isNaN(s.evaluateAsNumber(dummy_)));
   } // test15
 
+  void test16()
+  {
+    using namespace Arabica::XPath;
+    assertEquals(1.5, impl::stringAsNumber<string_type, string_adaptor>(SA::construct_from_utf8("1.5")), 0.0);
+    assertEquals(-0.25, impl::stringAsNumber<string_type, string_adaptor>(SA::construct_from_utf8(" \t-.25\n")), 0.0);
+    assertEquals(12.0, impl::stringAsNumber<string_type, string_adaptor>(SA::construct_from_utf8("12.")), 0.0);
+    assertEquals(7.0, impl::stringAsNumber<string_type, string_adaptor>(SA::construct_from_utf8("007")), 0.0);
+    assertEquals(0.1, impl::stringAsNumber<string_type, string_adaptor>(SA::construct_from_utf8("0.1")), 0.0);
+    assertEquals(123456789012345678.0, impl::stringAsNumber<string_type, string_adaptor>(SA::construct_from_utf8("123456789012345678")), 0.0);
+    assertEquals(0.1234567890123456789, impl::stringAsNumber<string_type, string_adaptor>(SA::construct_from_utf8("0.1234567890123456789")), 0.0);
+
+    const char* nans[] = { "", " ", ".", "-", "-.", "+1", "1.2.3", "1 2", "- 1", "1-", 
+                           "1e5", "1E5", "inf", "-inf", "nan", "Infinity", "0x10", "trousers", 0 };
+    for(const char** n = nans; *n != 0; ++n)
+      assertTrue(isNaN(impl::stringAsNumber<string_type, string_adaptor>(SA::construct_from_utf8(*n))));
+  } // test16
+
+  // the old conversion, minus exponent and inf/nan handling which XPath
+  // doesn't allow, is the reference for random strings
+  static double referenceStringAsNumber(const std::string& str)
+  {
+    std::string n_str = Arabica::text::normalize_whitespace<std::string, Arabica::default_string_adaptor<std::string> >(str);
+    if(n_str.find('+') == 0)
+      return Arabica::XPath::NaN;
+    try {
+      return boost::lexical_cast<double>(n_str);
+    } // try
+    catch(const boost::bad_lexical_cast&) {
+      return Arabica::XPath::NaN;
+    } // catch
+  } // referenceStringAsNumber
+
+  void test17()
+  {
+    using namespace Arabica::XPath;
+    const char alphabet[] = "0123456789012345.-+ \t\n";
+    unsigned long seed = 20061;
+    for(int run = 0; run != 20000; ++run)
+    {
+      std::string str;
+      seed = seed * 1103515245 + 12345;
+      int length = (seed >> 16) % 24;
+      for(int c = 0; c != length; ++c)
+      {
+        seed = seed * 1103515245 + 12345;
+        str += alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+      } // for ...
+
+      double expected = referenceStringAsNumber(str);
+      double actual = impl::stringAsNumber<string_type, string_adaptor>(SA::construct_from_utf8(str.c_str()));
+      if(isNaN(expected))
+        assertTrue(isNaN(actual));
+      else
+        assertEquals(expected, actual, 0.0);
+    } // for ...
+  } // test17
+
 }; // ValueTest
 
 template<class string_type, class string_adaptor>
@@ -191,6 +248,8 @@ TestSuite* ValueTest_suite()
   suiteOfTests->addTest(new TestCaller<ValueTest<string_type, string_adaptor> >("test13", &ValueTest<string_type, string_adaptor>::test13));
   suiteOfTests->addTest(new TestCaller<ValueTest<string_type, string_adaptor> >("test14", &ValueTest<string_type, string_adaptor>::test14));
   suiteOfTests->addTest(new TestCaller<ValueTest<string_type, string_adaptor> >("test15", &ValueTest<string_type, string_adaptor>::test15));
+  suiteOfTests->addTest(new TestCaller<ValueTest<string_type, string_adaptor> >("test16", &ValueTest<string_type, string_adaptor>::test16));
+  suiteOfTests->addTest(new TestCaller<ValueTest<string_type, string_adaptor> >("test17", &ValueTest<string_type, string_adaptor>::test17));
 
   return suiteOfTests;
 } // ValueTest_suite
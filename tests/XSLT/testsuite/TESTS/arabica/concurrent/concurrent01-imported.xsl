@@ -0,0 +1,12 @@
+<?xml version="1.0"?>
+<xsl:stylesheet version="1.0" xmlns:xsl="http://www.w3.org/1999/XSL/Transform">
+  <xsl:param name="prefix" select="'#'"/>
+
+  <xsl:template match="item" mode="list">
+    <listed n="{@n}"><xsl:value-of select="concat($prefix, .)"/></listed>
+  </xsl:template>
+
+  <xsl:template match="item">
+    <item n="{@n}" peers="{count(key('by-group', @group))}"/>
+  </xsl:template>
+</xsl:stylesheet>
@@ -0,0 +1,23 @@
+<?xml version="1.0"?>
+<xsl:stylesheet version="1.0" xmlns:xsl="http://www.w3.org/1999/XSL/Transform">
+  <!-- run on several threads at once by ConcurrentTransformationTest -->
+  <xsl:import href="concurrent01-imported.xsl"/>
+
+  <xsl:param name="group" select="'a'"/>
+  <xsl:key name="by-group" match="item" use="@group"/>
+
+  <xsl:template match="/">
+    <result group="{$group}" count="{count(key('by-group', $group))}">
+      <xsl:apply-templates select="items/item[@group = $group]" mode="list"/>
+      <xsl:apply-templates select="items/item[position() &lt;= 3]"/>
+    </result>
+  </xsl:template>
+
+  <xsl:template match="item" mode="list">
+    <xsl:apply-imports/>
+  </xsl:template>
+
+  <xsl:template match="item">
+    <wrapped><xsl:apply-imports/></wrapped>
+  </xsl:template>
+</xsl:stylesheet>
@@ -0,0 +1,28 @@
+<?xml version="1.0"?>
+<xsl:stylesheet version="1.0" xmlns:xsl="http://www.w3.org/1999/XSL/Transform">
+  <!-- run on several threads at once by ConcurrentTransformationTest, each sorting by its own parameters -->
+  <xsl:param name="group" select="'a'"/>
+  <xsl:param name="prefix" select="0"/>
+  <xsl:variable name="order" select="concat(substring('ascending', 1, 9 * ($group != 'b')), substring('descending', 1, 10 * ($group = 'b')))"/>
+
+  <xsl:template match="/">
+    <result group="{$group}" order="{$order}">
+      <sorted>
+        <xsl:for-each select="items/item">
+          <xsl:sort select="@group = $group" order="descending"/>
+          <xsl:sort select="(@n + $prefix) mod 4" data-type="number" order="{$order}"/>
+          <xsl:sort select="." data-type="number"/>
+          <xsl:sort select="."/>
+          <xsl:value-of select="@n"/>,</xsl:for-each>
+      </sorted>
+      <xsl:apply-templates select="items/item">
+        <xsl:sort select="string-length(.)" data-type="number" order="descending"/>
+        <xsl:sort select="." order="{$order}"/>
+      </xsl:apply-templates>
+    </result>
+  </xsl:template>
+
+  <xsl:template match="item">
+    <item n="{@n}" position="{position()}" last="{last()}"><xsl:value-of select="."/></item>
+  </xsl:template>
+</xsl:stylesheet>
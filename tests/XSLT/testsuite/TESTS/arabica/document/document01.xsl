@@ -0,0 +1,12 @@
+<xsl:stylesheet version="1.0" xmlns:xsl="http://www.w3.org/1999/XSL/Transform">
+  <xsl:template match="/">
+    <documents>
+      <same><xsl:value-of select="count(document('lookup.xml') | document('lookup.xml'))"/></same>
+      <relative><xsl:value-of select="count(document('lookup.xml') | document('../document/lookup.xml'))"/></relative>
+      <entries><xsl:value-of select="count(document('lookup.xml')//entry | document('lookup.xml')//entry)"/></entries>
+      <xsl:for-each select="order/line">
+        <line><xsl:value-of select="document('lookup.xml')/lookup/entry[@id = current()/@ref]"/> x <xsl:value-of select="."/></line>
+      </xsl:for-each>
+    </documents>
+  </xsl:template>
+</xsl:stylesheet>
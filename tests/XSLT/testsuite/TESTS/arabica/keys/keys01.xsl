@@ -0,0 +1,38 @@
+<?xml version="1.0"?>
+<xsl:stylesheet version="1.0" xmlns:xsl="http://www.w3.org/1999/XSL/Transform">
+  <xsl:output method="xml" indent="no"/>
+
+  <!-- several keys over the same document, of every kind of pattern -->
+  <xsl:key name="by-group" match="item" use="@g"/>
+  <xsl:key name="by-group" match="extra" use="@g"/>
+  <xsl:key name="twice" match="item | item[@g='a'] | list/item" use="@g"/>
+  <xsl:key name="texts" match="text()" use="."/>
+  <xsl:key name="any" match="node()" use="@id"/>
+  <xsl:key name="elements" match="*" use="@id"/>
+  <xsl:key name="listed" match="list/*" use="@g"/>
+  <xsl:key name="pis" match="processing-instruction()" use="."/>
+  <xsl:key name="comments" match="comment()" use="."/>
+
+  <xsl:template match="/">
+    <keys>
+      <xsl:for-each select="//@g[not(. = preceding::*/@g)]">
+        <xsl:variable name="g" select="."/>
+        <group name="{$g}">
+          <xsl:for-each select="key('by-group', $g)"><xsl:value-of select="@id"/>,</xsl:for-each>
+        </group>
+        <twice name="{$g}">
+          <xsl:for-each select="key('twice', $g)"><xsl:value-of select="@id"/>,</xsl:for-each>
+        </twice>
+        <listed name="{$g}">
+          <xsl:for-each select="key('listed', $g)"><xsl:value-of select="@id"/>,</xsl:for-each>
+        </listed>
+      </xsl:for-each>
+      <texts><xsl:for-each select="key('texts', 'one')"><xsl:value-of select="../@id"/>,</xsl:for-each></texts>
+      <any><xsl:for-each select="key('any', //@id)"><xsl:value-of select="@id"/>,</xsl:for-each></any>
+      <elements><xsl:value-of select="name(key('elements', 'e2'))"/>,<xsl:value-of select="count(key('elements', 'a'))"/></elements>
+      <pis><xsl:value-of select="name(key('pis', 'here'))"/></pis>
+      <comments><xsl:value-of select="count(key('comments', 'a comment'))"/></comments>
+      <union><xsl:for-each select="key('by-group', //item/@g)"><xsl:value-of select="@id"/>,</xsl:for-each></union>
+    </keys>
+  </xsl:template>
+</xsl:stylesheet>
@@ -27,6 +27,8 @@
 #include <string> 
 
 #include <fstream>
+#include <thread>
+#include <vector>
 
 class Expected;
 
@@ -576,6 +578,189 @@ protected:
   std::string output_xml_;
 }; // class StandardXSLTTest
 
+// Runs one compiled stylesheet on several threads at once, each thread 
+// with a Transformation and document of its own, and checks every run
+// gives what the same transformation did run by itself.
+template<class string_type, class string_adaptor>
+class ConcurrentTransformationTest : public TestCase
+{
+  typedef Arabica::XSLT::Stylesheet<string_type, string_adaptor> StylesheetT;
+public:
+  ConcurrentTransformationTest(const std::string& name,
+                               const std::string& input_xml,
+                               const std::string& input_xslt) :
+    TestCase(name),
+    input_xml_(input_xml),
+    input_xslt_(input_xslt)
+  {
+  } // ConcurrentTransformationTest
+
+protected:
+  virtual void runTest()
+  {
+    Arabica::XSLT::StylesheetCompiler<string_type, string_adaptor> compiler;
+    Arabica::SAX::InputSource<string_type, string_adaptor> source(string_adaptor::construct(input_xslt_));
+    std::auto_ptr<StylesheetT> stylesheet = compiler.compile(source);
+    if(stylesheet.get() == 0)
+      assertImplementation(false, "Failed to compile " + input_xslt_ + " : " + compiler.error());
+
+    const int threads = 8;
+    const int runs = 20;
+    std::vector<std::string> expected;
+    for(int t = 0; t != threads; ++t)
+      expected.push_back(run(*stylesheet, buildDOM<string_type, string_adaptor>(input_xml_), t));
+
+    std::vector<int> failures(threads);
+    std::vector<std::thread> running;
+    for(int t = 0; t != threads; ++t)
+      running.push_back(std::thread(Runs(*stylesheet, input_xml_, t, runs, expected[t], &failures[t])));
+    for(int t = 0; t != threads; ++t)
+      running[t].join();
+
+    for(int t = 0; t != threads; ++t)
+      assertLongsEqual(0, failures[t]);
+  } // runTest
+
+private:
+  static std::string run(const StylesheetT& stylesheet, const Arabica::DOM::Document<string_type, string_adaptor>& document, int thread)
+  {
+    const char* groups[] = { "a", "b", "c" };
+    std::basic_ostringstream<typename string_adaptor::value_type> xml_output;
+    Arabica::XSLT::StreamSink<string_type, string_adaptor> output(xml_output);
+    std::basic_ostringstream<typename string_adaptor::value_type> errors;
+
+    std::auto_ptr<Arabica::XSLT::Transformation<string_type, string_adaptor> > transformation = stylesheet.create_transformation();
+    transformation->set_output(output);
+    transformation->set_error_output(errors);
+    transformation->set_parameter(string_adaptor::construct("group"), groups[thread % 3]);
+    if(thread % 2)
+      transformation->set_parameter(string_adaptor::construct("prefix"), static_cast<double>(thread));
+    transformation->execute(document);
+    return string_adaptor::asStdString(string_adaptor::construct(xml_output.str()));
+  } // run
+
+  class Runs
+  {
+  public:
+    Runs(const StylesheetT& stylesheet, const std::string& input_xml, int thread, int runs, const std::string& expected, int* failures) :
+      stylesheet_(stylesheet), input_xml_(input_xml), thread_(thread), runs_(runs), expected_(expected), failures_(failures) { }
+
+    void operator()() const
+    {
+      try {
+        for(int r = 0; r != runs_; ++r)
+          if(run(stylesheet_, buildDOM<string_type, string_adaptor>(input_xml_), thread_) != expected_)
+            ++*failures_;
+      }
+      catch(...) {
+        ++*failures_;
+      } // catch
+    } // operator()
+
+  private:
+    const StylesheetT& stylesheet_;
+    const std::string input_xml_;
+    const int thread_;
+    const int runs_;
+    const std::string expected_;
+    int* failures_;
+  }; // class Runs
+
+  std::string input_xml_;
+  std::string input_xslt_;
+}; // class ConcurrentTransformationTest
+
+// Uses a key on document after document, some of which the key finds 
+// nothing in, and with the stylesheet keeping its key indexes for fewer 
+// documents than it's given, or releasing them outright.
+template<class string_type, class string_adaptor>
+class KeyIndexTest : public TestCase
+{
+  typedef Arabica::XSLT::Stylesheet<string_type, string_adaptor> StylesheetT;
+  typedef Arabica::DOM::Document<string_type, string_adaptor> DocumentT;
+public:
+  KeyIndexTest(const std::string& name) :
+    TestCase(name)
+  {
+  } // KeyIndexTest
+
+protected:
+  virtual void runTest()
+  {
+    std::stringstream xslt;
+    xslt << "<xsl:stylesheet version='1.0' xmlns:xsl='http://www.w3.org/1999/XSL/Transform'>"
+         << "<xsl:output method='text'/>"
+         << "<xsl:key name='k' match='item' use='@g'/>"
+         << "<xsl:template match='/'>"
+         << "<xsl:value-of select='count(key(\"k\", \"x\"))'/>:"
+         << "<xsl:for-each select='key(\"k\", \"x\")'><xsl:value-of select='@id'/></xsl:for-each>"
+         << "</xsl:template>"
+         << "</xsl:stylesheet>";
+    Arabica::XSLT::StylesheetCompiler<string_type, string_adaptor> compiler;
+    Arabica::SAX::InputSource<string_type, string_adaptor> source(xslt);
+    std::auto_ptr<StylesheetT> stylesheet = compiler.compile(source);
+    if(stylesheet.get() == 0)
+      assertImplementation(false, "Failed to compile : " + compiler.error());
+
+    // each document goes as soon as it's been transformed, and the next is
+    // likely to turn up where it was
+    for(int i = 0; i != 40; ++i)
+      assertEquals(expected(i), run(*stylesheet, document(i)));
+
+    stylesheet->set_key_index_limit(1);
+    DocumentT one = document(3);
+    DocumentT two = document(5);
+    for(int i = 0; i != 3; ++i)
+    {
+      assertEquals(expected(3), run(*stylesheet, one));
+      assertEquals(expected(5), run(*stylesheet, two));
+    } // for ...
+
+    stylesheet->release_key_indexes(one);
+    stylesheet->release_key_indexes(two);
+    assertEquals(expected(3), run(*stylesheet, one));
+
+    stylesheet->set_key_index_limit(0);
+    assertEquals(expected(5), run(*stylesheet, two));
+    assertEquals(expected(6), run(*stylesheet, document(6)));
+  } // runTest
+
+private:
+  // odd numbered documents have that many items the key finds, even 
+  // numbered ones none at all
+  static DocumentT document(int n)
+  {
+    std::ostringstream xml;
+    xml << "<doc>";
+    for(int i = 0; i != n; ++i)
+      xml << "<item id='" << i << "' g='" << ((n % 2) ? "x" : "y") << "'/>";
+    xml << "</doc>";
+    return buildDOMFromString<string_type, string_adaptor>(xml.str());
+  } // document
+
+  static std::string expected(int n)
+  {
+    std::ostringstream result;
+    result << ((n % 2) ? n : 0) << ":";
+    for(int i = 0; (n % 2) && (i != n); ++i)
+      result << i;
+    return result.str();
+  } // expected
+
+  static std::string run(const StylesheetT& stylesheet, const DocumentT& document)
+  {
+    std::basic_ostringstream<typename string_adaptor::value_type> text_output;
+    Arabica::XSLT::StreamSink<string_type, string_adaptor> output(text_output);
+    std::basic_ostringstream<typename string_adaptor::value_type> errors;
+
+    std::auto_ptr<Arabica::XSLT::Transformation<string_type, string_adaptor> > transformation = stylesheet.create_transformation();
+    transformation->set_output(output);
+    transformation->set_error_output(errors);
+    transformation->execute(document);
+    return string_adaptor::asStdString(string_adaptor::construct(text_output.str()));
+  } // run
+}; // class KeyIndexTest
+
 class Expected 
 {
 public:
@@ -750,8 +935,8 @@ const char* msft_tests[] = { "AVTs", /*"AttributeSets",*/ "Attributes", "BVTs",
                              "Stylesheet", "Template", "Text",  "Valueof",
                              "Variables", "Whitespaces", "XSLTFunctions", 0 };
 
-const char* arabica_tests[] = { "attributes",
-                                "errors", "include", "processing-instruction", 
+const char* arabica_tests[] = { "attributes", "concurrent",
+                                "errors", "include", "keys", "processing-instruction", 
                                 "stylesheet", "text", "variables", 0 };
 
 template<class string_type, class string_adaptor>
@@ -768,6 +953,25 @@ bool XSLT_test_suite(int argc, const char* argv[])
   add_tests(runner, loader, tests_to_run, msft_tests);
   add_arabica_tests(runner, loader, tests_to_run, arabica_tests);
 
+  if(tests_to_run.empty() || (tests_to_run.find("threads") != tests_to_run.end()))
+  {
+    TestSuite* threads = new TestSuite;
+    threads->addTest(new ConcurrentTransformationTest<string_type, string_adaptor>("concurrent01-threads", 
+                                                                                   make_path("arabica/concurrent", "concurrent01.xml"),
+                                                                                   make_path("arabica/concurrent", "concurrent01.xsl")));
+    threads->addTest(new ConcurrentTransformationTest<string_type, string_adaptor>("concurrent02-threads", 
+                                                                                   make_path("arabica/concurrent", "concurrent01.xml"),
+                                                                                   make_path("arabica/concurrent", "concurrent02.xsl")));
+    runner.addTest("threads", threads);
+  } // if ...
+
+  if(tests_to_run.empty() || (tests_to_run.find("keyindex") != tests_to_run.end()))
+  {
+    TestSuite* keyindex = new TestSuite;
+    keyindex->addTest(new KeyIndexTest<string_type, string_adaptor>("keyindex"));
+    runner.addTest("keyindex", keyindex);
+  } // if ...
+
   return runner.run(argc, argv);
 }  // XSLT_test_suite
 
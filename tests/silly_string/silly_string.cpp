@@ -135,6 +135,11 @@ void silly_string_adaptor::append(silly_string& str, const char& a)
   str.s_ += a;
 } // append
 
+void silly_string_adaptor::reserve(silly_string& str, size_type n)
+{
+  str.s_.reserve(n);
+} // reserve
+
 silly_string silly_string_adaptor::concat(const silly_string& str, const silly_string& a)
 {
   return construct(str.s_ + a.s_);
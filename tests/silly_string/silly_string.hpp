@@ -88,6 +88,7 @@ public:
   static size_type length(const silly_string& str);
   static void append(silly_string& str, const silly_string& a);
   static void append(silly_string& str, const char& a);
+  static void reserve(silly_string& str, size_type n);
   static silly_string concat(const silly_string& str, const silly_string& a);
   static silly_string concat(const silly_string& str, const char& a);
   static void insert(silly_string& str, size_type offset, const silly_string& a);